@@ -1,6 +1,15 @@
 # Targets
 EMULATOR = build/b6x
 ZPTOOL = build/b6xzp
+BATCHRUN = build/b6xbatch
+AOTTOOL = build/b6xaot
+TRACETOOL = build/b6xtrace
+
+# Profiling hooks (0 to compile them out)
+PROF = 1
+
+# Translated ROM code to link in, output of b6xaot (empty for none)
+AOT =
 
 # Installation path
 PREFIX = /usr/local
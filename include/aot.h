@@ -0,0 +1,96 @@
+#ifndef AOT_H
+#define AOT_H
+
+#include <stdint.h>
+
+#include "uxn.h"
+
+/* ==========================================================================
+   B6X AHEAD-OF-TIME CODE SUPPORT, INCLUDED BY THE OUTPUT OF B6XAOT
+   ========================================================================== */
+
+/* Translated instructions fall through to the next case on purpose */
+#pragma GCC diagnostic ignored "-Wimplicit-fallthrough"
+
+/* === Stack and memory access, same as in the interpreter === */
+#define DEC s[--(*p)]
+#define INC s[(*p)++]
+#define FLIP s = u->stk[!r], p = &u->ptr[!r];
+#define RELA pc + (int8_t)a
+#define DROP(o,m) o = DEC; if(m) o |= DEC << 8;
+#define TAKE(o) if(d) o[1] = DEC; o[0] = DEC;
+#define PUSH(i,m) { if(m) c = (i), INC = c >> 8, INC = c; else INC = i; }
+#define GIVE(i) INC = i[0]; if(d) INC = i[1];
+#define SYNC u->icount += n, n = 0;
+#define DEVO(o,r) SYNC aot_deo(u, o, r[0]); if(d) aot_deo(u, o + 1, r[1]);
+#define DEVI(i,r) SYNC r[0] = aot_dei(u, i); if(d) r[1] = aot_dei(u, i + 1);
+/* ROMs without a window in the header skip the check, see b6xaot, and
+   leave machines with an enabled window to the interpreter */
+#ifdef AOT_WINDOW
+#define WIN(o,n) ((uint16_t)((o) - u->win_base) < u->n)
+#define STORE(o,v) { uint16_t w = o;                                       \
+    if(WIN(w,win_span)) u->win_store(u, w, v); else u->ram[w] = v; }
+#define LOAD(i) (WIN(i,win_size) ? u->win[(uint16_t)((i) - u->win_base)]  \
+                                 : u->ram[i])
+#define AOT_WINDOW_OFF
+#else
+#define STORE(o,v) u->ram[(uint16_t)(o)] = v;
+#define LOAD(i) u->ram[i]
+#define AOT_WINDOW_OFF if (u->win_span) return uxn_interp(u, pc);
+#endif
+#define POKE(o,r,m) STORE(o, r[0]) if(d) STORE((o + 1) & m, r[1])
+#define PEEK(i,r,m) r[0] = LOAD(i); if(d) r[1] = LOAD((i + 1) & m);
+
+static inline uint8_t aot_dei(struct uxn *u, uint8_t port) {
+    if (u->dei_handlers[port]) return u->dei_handlers[port](u, u->dev+port);
+    return u->dev[port];
+}
+
+static inline void aot_deo(struct uxn *u, uint8_t port, uint8_t value) {
+    u->dev[port] = value;
+    if (u->deo_handlers[port]) u->deo_handlers[port](u, u->dev+port);
+}
+
+/* === Translated function frame === */
+#define AOT_BEGIN                                                          \
+    uint16_t a = 0, b = 0, c = 0, x[2] = {0}, y[2] = {0}, z[2] = {0};      \
+    uint32_t n = 0;                                                        \
+    (void)a; (void)b; (void)c; (void)x; (void)y; (void)z;                  \
+    AOT_WINDOW_OFF                                                         \
+dispatch:                                                                  \
+    switch (pc) {
+
+#define AOT_END                                                            \
+    default: goto fallback;                                                \
+    }                                                                      \
+fallback:                                                                  \
+    u->icount += n;                                                        \
+    return uxn_interp(u, pc);
+
+/* === Instruction at A, left for the interpreter if the opcode changed === */
+#define AOT_AT(A)    case A:
+#define AOT_ATL(A)   case A: L_##A:
+
+#define AOT_OP(A, OP, R, LEN)                                              \
+    if (u->ram[A] != (OP)) { pc = A; goto fallback; }                      \
+    pc = (uint16_t)((A) + (LEN));                                          \
+    { const int r = R;                                                     \
+      uint8_t *s = u->stk[r], *p = &u->ptr[r]; (void)s; (void)p;
+
+/* Immediate jumps also check their operand, the target is static */
+#define AOT_OPI(A, OP, HI, LO)                                             \
+    if (u->ram[A] != (OP) || u->ram[((A) + 1) & 0xffff] != (HI) ||         \
+        u->ram[((A) + 2) & 0xffff] != (LO)) { pc = A; goto fallback; }     \
+    pc = (uint16_t)((A) + 3);                                              \
+    { const int r = (OP) >> 6 & 1;                                         \
+      uint8_t *s = u->stk[r], *p = &u->ptr[r]; (void)s; (void)p;
+
+/* Next instruction, pc is left past this one unless it jumped */
+#define AOT_NEXT(A, LEN) } n++;                                            \
+    if (pc != (uint16_t)((A) + (LEN))) goto dispatch;
+
+#define AOT_GOTO(T)  { n++; goto L_##T; }   /* - Translated target     */
+#define AOT_JUMP(T)  { pc = T; n++; goto dispatch; }
+#define AOT_BRK      } u->icount += n + 1; return 1;
+
+#endif /* AOT_H */
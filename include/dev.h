@@ -1,42 +1,134 @@
-#ifndef DEV_H
-#define DEV_H
-
-#include <stdint.h>
-
-#define PEEK2(addr, mem, mask) \
-    (mem[(addr) & (mask)] << 8 | mem[((addr)+1) & (mask)])
-
-#define POKE2(addr, mem, mask, value) \
-    { uint16_t v = value;             \
-      mem[(addr) & (mask)] = v >> 8;  \
-      mem[((addr)+1) & (mask)] = v; } \
-
-void dev_init(void);
-
-void    dev_vdp_deo(uint8_t *port);
-uint8_t dev_vdp_dei(uint8_t *port);
-void    dev_vdp(uint32_t *buffer);
-
-uint8_t dev_ctl_dei(uint8_t *port);
-void    dev_ctl_deo(uint8_t *port);
-void    dev_ctl(uint8_t code);
-
-void    dev_rom_deo(uint8_t *port);
-void    dev_rom_open(const char *fname);
-void    dev_rom_close(void);
-
-uint8_t dev_rst_dei(uint8_t *port);
-void    dev_rst_deo(uint8_t *port);
-
-uint8_t dev_wst_dei(uint8_t *port);
-void    dev_wst_deo(uint8_t *port);
-
-uint8_t dev_snd_dei(uint8_t *port);
-void    dev_snd_deo(uint8_t *port);
-
-uint8_t dev_dbg_dei(uint8_t *port);
-void    dev_dbg_deo(uint8_t *port);
-
-void    dev_meta_deo(uint8_t *port);
-
+#ifndef DEV_H
+#define DEV_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "uxn.h"
+
+#define PEEK2(addr, mem, mask) \
+    (mem[(addr) & (mask)] << 8 | mem[((addr)+1) & (mask)])
+
+#define POKE2(addr, mem, mask, value) \
+    { uint16_t v = value;             \
+      mem[(addr) & (mask)] = v >> 8;  \
+      mem[((addr)+1) & (mask)] = v; } \
+
+struct vdp {
+    uint16_t regs[32],    cram[64];
+    uint8_t  vram[65536], cgram[1024];
+
+    uint32_t frame;         /* - Frames since power-on                   */
+    uint16_t line;          /* - Line being drawn, 224 during V-blank    */
+    uint8_t  speculative;   /* - Frame run ahead, discarded afterwards   */
+    uint8_t  redraw;        /* - Host has no picture, draw the next
+                                 shown frame even if nothing changed     */
+
+    uint16_t port_addr;     /* - Data port VRAM address                  */
+    uint16_t port_inc;      /* - Data port address increment             */
+    uint16_t port_left;     /* - Words left in the data port stream      */
+    uint8_t  port_read;     /* - Stream is served by DEI instead of DEO  */
+
+    uint16_t collide[8];    /* - Sprites that touched another sprite in
+                                 the last frame, one bit per SAT entry   */
+};
+
+struct rom {
+    const uint8_t *data;    /* - ROM image, may be shared by machines    */
+    size_t         size;
+    uint8_t       *owned;   /* - Image to free on close, if loaded here  */
+
+    uint8_t  step;          /* - Position in the 3-write DMA protocol    */
+    uint16_t src, dst;
+
+    uint16_t bank;          /* - ROM page shown in the window            */
+    uint16_t win_base;      /* - Window reserved by the header, enabled  */
+    uint16_t win_span;      /*   by a read of the port                   */
+};
+
+#define CTL_QUEUE 64       /* - Pending controller events, power of 2   */
+
+struct ctl {
+    uint8_t  btn;           /* - Event code being delivered              */
+    uint16_t vec;           /* - Controller vector                       */
+
+    uint8_t  queue[CTL_QUEUE];
+    uint32_t head, tail;    /* - Next event to deliver, next free slot   */
+};
+
+struct dbg {
+    uint64_t icount_base;   /* - icount at the last counter reset        */
+    uint32_t counter;       /* - Counter latched by the last select      */
+    uint8_t  counter_byte;  /* - Next byte of it to read                 */
+};
+
+struct cop {
+    uint8_t  result[8];     /* - Two 32-bit results, big-endian          */
+    uint8_t  pos;           /* - Next result byte to read                */
+};
+
+struct prof;
+
+/* === Complete B6X machine, one per emulated console === */
+struct b6x {
+    struct uxn   uxn;       /* - CPU, must be the first member           */
+    struct vdp   vdp;
+    struct rom   rom;
+    struct ctl   ctl;
+    struct dbg   dbg;
+    struct cop   cop;
+    struct prof *prof;      /* - Attached profiler or NULL               */
+};
+
+#define B6X(u) ((struct b6x *)(u))
+
+void dev_init(struct b6x *m); /* - Expects a zeroed machine */
+void dev_runahead(struct b6x *m, struct b6x *state,
+                  uint32_t *buffer, uint8_t frames);
+void dev_runahead_indexed(struct b6x *m, struct b6x *state,
+                          uint8_t *index, uint16_t *palette, uint8_t frames);
+
+void    dev_vdp_deo(struct uxn *u, uint8_t *port);
+uint8_t dev_vdp_dei(struct uxn *u, uint8_t *port);
+void    dev_vdp(struct b6x *m, uint32_t *buffer); /* - NULL: hidden frame */
+
+/* Indexed output: 320x224 CRAM indices (bit 7 inverts the color) and
+   224 copies of the 64 CRAM entries, one per line. Left untouched when
+   nothing was written to the VDP, like the ARGB buffer. */
+void    dev_vdp_indexed(struct b6x *m, uint8_t *index, uint16_t *palette);
+void    dev_vdp_convert(const uint8_t *index, const uint16_t *palette,
+                                                   uint32_t *buffer);
+
+uint8_t dev_ctl_dei(struct uxn *u, uint8_t *port);
+void    dev_ctl_deo(struct uxn *u, uint8_t *port);
+void    dev_ctl(struct b6x *m, uint8_t code);
+void    dev_ctl_flush(struct b6x *m);
+
+uint8_t dev_rom_dei(struct uxn *u, uint8_t *port);
+void    dev_rom_deo(struct uxn *u, uint8_t *port);
+void    dev_rom_window(struct uxn *u, uint16_t addr, uint8_t value);
+void    dev_rom_read(struct b6x *m, uint8_t *mem, size_t addr, size_t size,
+                                              uint16_t page, size_t num);
+uint8_t *dev_rom_load(const char *fname, size_t *size);
+void    dev_rom_attach(struct b6x *m, const uint8_t *data, size_t size);
+void    dev_rom_open(struct b6x *m, const char *fname);
+void    dev_rom_close(struct b6x *m);
+
+uint8_t dev_rst_dei(struct uxn *u, uint8_t *port);
+void    dev_rst_deo(struct uxn *u, uint8_t *port);
+
+uint8_t dev_wst_dei(struct uxn *u, uint8_t *port);
+void    dev_wst_deo(struct uxn *u, uint8_t *port);
+
+uint8_t dev_snd_dei(struct uxn *u, uint8_t *port);
+void    dev_snd_deo(struct uxn *u, uint8_t *port);
+
+uint8_t dev_cop_dei(struct uxn *u, uint8_t *port);
+void    dev_cop_deo(struct uxn *u, uint8_t *port);
+
+uint8_t dev_dbg_dei(struct uxn *u, uint8_t *port);
+void    dev_dbg_deo(struct uxn *u, uint8_t *port);
+
+void    dev_meta_deo(struct uxn *u, uint8_t *port);
+
 #endif /* DEV_H */
\ No newline at end of file
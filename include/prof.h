@@ -0,0 +1,62 @@
+#ifndef PROF_H
+#define PROF_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define PROF_HISTORY 320 /* - Frames kept for the overlay graph */
+
+/* === Frame timers === */
+enum { PROF_VBLANK, PROF_HBLANK, PROF_RASTER, PROF_PRESENT, PROF_TIMERS };
+
+struct prof_frame {
+    uint64_t time[PROF_TIMERS]; /* - Nanoseconds spent in each timer      */
+    uint64_t instrs;            /* - UXN instructions executed            */
+    uint64_t vdp_bytes;         /* - VRAM bytes moved by VDP copy/fill    */
+    uint64_t rom_bytes;         /* - Bytes loaded from ROM                */
+    uint64_t vdp_cmds[32];      /* - dev_vdp_deo command histogram        */
+};
+
+struct b6x;
+
+struct prof {
+    struct b6x       *machine;  /* - Machine being profiled               */
+    struct prof_frame cur;      /* - Frame being measured                 */
+    struct prof_frame sum, max; /* - Totals and peaks of the period       */
+    uint64_t frame_max;         /* - Longest frame of the period (ns)     */
+    uint64_t frame, frames;     /* - Frame number, frames in period       */
+    uint64_t icount;            /* - uxn_icount at the start of the frame */
+
+    uint32_t history[PROF_HISTORY][PROF_TIMERS];
+
+    FILE    *out;               /* - Periodic dump destination or NULL    */
+    int      json;              /* - Dump JSON lines instead of CSV       */
+    uint32_t period;            /* - Frames per dump record               */
+};
+
+uint64_t prof_now(void);
+void     prof_start(struct prof *p, struct b6x *m,
+                    FILE *out, int json, uint32_t period);
+void     prof_stop(struct prof *p);
+void     prof_frame(struct prof *p);
+void     prof_overlay(struct prof *p, uint32_t *buffer, int width, int height);
+
+/* === Hooks on machine m, compiled out with B6X_NO_PROF === */
+#ifndef B6X_NO_PROF
+#define PROF_NOW(m)           ((m)->prof ? prof_now() : 0)
+#define PROF_SINCE(m, t, t0)  do { if ((m)->prof)                          \
+                                   (m)->prof->cur.time[t] +=               \
+                                                   prof_now() - (t0);      \
+                              } while (0)
+#define PROF_TIME(m, t, stmt) do { uint64_t prof_t0 = PROF_NOW(m); stmt;   \
+                                   PROF_SINCE(m, t, prof_t0); } while (0)
+#define PROF_ADD(m, f, n)     do { if ((m)->prof) (m)->prof->cur.f += (n); \
+                              } while (0)
+#else
+#define PROF_NOW(m)           0
+#define PROF_SINCE(m, t, t0)  do { (void)(t0); } while (0)
+#define PROF_TIME(m, t, stmt) do { stmt; } while (0)
+#define PROF_ADD(m, f, n)     do { } while (0)
+#endif
+
+#endif /* PROF_H */
\ No newline at end of file
@@ -0,0 +1,48 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* ==========================================================================
+   B6X SHARED-MEMORY FRAME EXPORT, LAYOUT SHARED WITH READERS
+   ========================================================================== */
+
+#define SHM_MAGIC   0x46583642 /* - "B6XF" little-endian             */
+#define SHM_VERSION 1
+#define SHM_SLOTS   4          /* - Frames kept in the ring          */
+
+/* === One frame of the ring, pixels are 0x00RRGGBB === */
+struct shm_slot {
+    uint32_t lock;             /* - Odd while the slot is written    */
+    uint32_t pad;
+    uint64_t frame;            /* - Frame number, counts from 1      */
+    uint64_t time_ns;          /* - CLOCK_MONOTONIC when finished    */
+};
+
+struct shm_header {
+    uint32_t magic, version;
+    uint32_t width, height;
+    uint32_t slots;
+    uint32_t offset;           /* - First slot's pixels from the top */
+    uint64_t frame;            /* - Last finished frame, 0 for none  */
+
+    struct shm_slot slot[SHM_SLOTS];
+};
+
+/* Frame f is in slot (f - 1) % SHM_SLOTS, its pixels at
+   offset + slot * width * height * 4. A reader checks that the slot's lock
+   is even and unchanged after reading, and its frame number. */
+
+struct shm {
+    struct shm_header *header; /* - Mapping, NULL when not exporting */
+    size_t             size;
+    char               name[256];
+};
+
+int  shm_export_open(struct shm *s, const char *name,
+                     uint32_t width, uint32_t height);
+void shm_export_close(struct shm *s);
+void shm_export_frame(struct shm *s, const uint32_t *buffer, uint64_t time_ns);
+
+#endif /* SHM_H */
@@ -0,0 +1,61 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_ENTRIES (1 << 22) /* - Default ring size, 32 MB              */
+#define TRACE_LATE_US 17500     /* - Longer frames are late, 5% over 60 FPS */
+#define TRACE_QUIET   60        /* - Frames not checked after a dump        */
+
+/* === Entry kinds, addr and data meaning per kind === */
+enum {
+    TRACE_OP,     /* - Instruction op at addr, data: WST | RST << 8 ptrs  */
+    TRACE_VECTOR, /* - Vector entered at addr, data: time in us           */
+    TRACE_BRK,    /* - Vector at addr returned, data: time in us          */
+    TRACE_DEO,    /* - Output of data to port addr                        */
+    TRACE_DEI,    /* - Input of data from port addr                       */
+    TRACE_FRAME,  /* - Frame addr started, op: 1 if run ahead, data: time */
+    TRACE_LINE    /* - Scanline addr started                              */
+};
+
+/* Dump file: "B6XT", version, 0, entry size, 0, u32 entry count,
+   u64 entries recorded, then the entries oldest first as kind, op,
+   u16 addr, u32 data. All numbers are little-endian. */
+struct trace_entry {
+    uint8_t  kind, op;
+    uint16_t addr;
+    uint32_t data;
+};
+
+struct uxn;
+
+struct trace {
+    struct trace_entry *ring;
+    uint64_t    head;     /* - Entries recorded since the start          */
+    uint32_t    mask;     /* - Ring size - 1, the size is a power of 2   */
+    const char *path;     /* - Dump destination                          */
+
+    uint8_t     on_late;  /* - Flag late frames for a dump               */
+    uint8_t     late;     /* - A frame took longer than TRACE_LATE_US    */
+    uint32_t    quiet;    /* - Frames left before checking again         */
+    uint32_t    start;    /* - Start of the last frame run, in us        */
+};
+
+int      trace_start(struct trace *t, struct uxn *u,
+                     uint32_t entries, const char *path);
+void     trace_stop(struct trace *t, struct uxn *u);
+int      trace_dump(struct trace *t);
+void     trace_frame(struct trace *t, uint32_t frame, uint8_t speculative);
+uint32_t trace_time(void);
+
+static inline void trace_put(struct trace *t, uint8_t kind, uint8_t op,
+                             uint16_t addr, uint32_t data) {
+    struct trace_entry *e = &t->ring[t->head++ & t->mask];
+
+    e->kind = kind;
+    e->op   = op;
+    e->addr = addr;
+    e->data = data;
+}
+
+#endif /* TRACE_H */
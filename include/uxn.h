@@ -1,12 +1,36 @@
-#ifndef UXN_H
-#define UXN_H
-
-#include <stdint.h>
-
-extern uint8_t uxn_ram[65536], uxn_dev[256], uxn_ptr[2], uxn_stk[2][256];
-extern void    (*uxn_deo_handlers[256])(uint8_t *port);
-extern uint8_t (*uxn_dei_handlers[256])(uint8_t *port);
-
-uint32_t uxn_eval(uint16_t pc);
-
+#ifndef UXN_H
+#define UXN_H
+
+#include <stdint.h>
+
+struct trace;
+
+struct uxn {
+    uint8_t ram[0x10000], dev[0x100], ptr[2], stk[2][0x100];
+
+    void    (*deo_handlers[256])(struct uxn *u, uint8_t *port);
+    uint8_t (*dei_handlers[256])(struct uxn *u, uint8_t *port);
+
+    uint64_t icount; /* - Instructions executed, updated on BRK/DEI/DEO */
+    uint64_t vstart; /* - Value of icount on entry to the vector        */
+
+    /* Read-only window: loads of the first win_size bytes from win_base
+       are served from win, stores to the first win_span go to win_store */
+    const uint8_t *win;
+    uint16_t       win_base, win_size, win_span;
+    void         (*win_store)(struct uxn *u, uint16_t addr, uint8_t value);
+
+    /* Translated code tried before the interpreter, see b6xaot */
+    uint32_t (*native)(struct uxn *u, uint16_t pc);
+
+    struct trace *trace; /* - Execution trace, NULL when not tracing */
+};
+
+uint32_t uxn_eval(struct uxn *u, uint16_t pc);
+uint32_t uxn_interp(struct uxn *u, uint16_t pc); /* - Skips native code */
+
+#ifdef B6X_AOT
+uint32_t aot_eval(struct uxn *u, uint16_t pc);   /* - Output of b6xaot   */
+#endif
+
 #endif /* UXN_H */
\ No newline at end of file
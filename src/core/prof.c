@@ -0,0 +1,185 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "dev.h"
+#include "prof.h"
+#include "uxn.h"
+
+/* ==========================================================================
+   B6X HOST PROFILER
+   ========================================================================== */
+
+#define OVERLAY_H 56       /* - Overlay graph height in pixels  */
+#define BUDGET    16666667 /* - Frame budget at 60 FPS (ns)     */
+
+#define WORDS (sizeof(struct prof_frame) / sizeof(uint64_t))
+
+static const char *timer_names[PROF_TIMERS] = {
+    "vblank", "hblank", "raster", "present"
+};
+
+static const uint32_t timer_colors[PROF_TIMERS] = {
+    0x40FF40, 0xFFFF40, 0x4080FF, 0xFF40FF
+};
+
+uint64_t prof_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void dump_csv(struct prof *p) {
+    uint64_t n = p->frames;
+
+    fprintf(p->out, "%llu,%llu", (unsigned long long)p->frame,
+                                 (unsigned long long)n);
+    for (int t = 0; t < PROF_TIMERS; t++)
+        fprintf(p->out, ",%llu,%llu",
+                (unsigned long long)(p->sum.time[t] / n / 1000),
+                (unsigned long long)(p->max.time[t] / 1000));
+    fprintf(p->out, ",%llu,%llu,%llu,%llu,%llu",
+            (unsigned long long)(p->frame_max / 1000),
+            (unsigned long long)(p->sum.instrs / n),
+            (unsigned long long)p->max.instrs,
+            (unsigned long long)p->sum.vdp_bytes,
+            (unsigned long long)p->sum.rom_bytes);
+    for (int i = 0; i < 32; i++)
+        fprintf(p->out, ",%llu", (unsigned long long)p->sum.vdp_cmds[i]);
+    fputc('\n', p->out);
+}
+
+static void dump_json(struct prof *p) {
+    uint64_t n = p->frames;
+
+    fprintf(p->out, "{\"frame\":%llu,\"frames\":%llu",
+            (unsigned long long)p->frame, (unsigned long long)n);
+    for (int t = 0; t < PROF_TIMERS; t++)
+        fprintf(p->out, ",\"%s_us\":{\"avg\":%llu,\"max\":%llu}",
+                timer_names[t],
+                (unsigned long long)(p->sum.time[t] / n / 1000),
+                (unsigned long long)(p->max.time[t] / 1000));
+    fprintf(p->out, ",\"frame_max_us\":%llu"
+                    ",\"instrs\":{\"avg\":%llu,\"max\":%llu}"
+                    ",\"vdp_bytes\":%llu,\"rom_bytes\":%llu,\"vdp_cmds\":[",
+            (unsigned long long)(p->frame_max / 1000),
+            (unsigned long long)(p->sum.instrs / n),
+            (unsigned long long)p->max.instrs,
+            (unsigned long long)p->sum.vdp_bytes,
+            (unsigned long long)p->sum.rom_bytes);
+    for (int i = 0; i < 32; i++)
+        fprintf(p->out, "%s%llu", i ? "," : "",
+                (unsigned long long)p->sum.vdp_cmds[i]);
+    fputs("]}\n", p->out);
+}
+
+static void dump(struct prof *p) {
+    if (p->out && p->frames) {
+        if (p->json) dump_json(p); else dump_csv(p);
+        fflush(p->out);
+    }
+
+    memset(&p->sum, 0, sizeof p->sum);
+    memset(&p->max, 0, sizeof p->max);
+    p->frame_max = 0;
+    p->frames    = 0;
+}
+
+void prof_start(struct prof *p, struct b6x *m,
+                FILE *out, int json, uint32_t period) {
+    memset(p, 0, sizeof *p);
+
+    p->machine = m;
+    p->out     = out;
+    p->json    = json;
+    p->period  = period ? period : 60;
+    p->icount  = m->uxn.icount;
+
+    if (out && !json) {
+        fputs("frame,frames", out);
+        for (int t = 0; t < PROF_TIMERS; t++)
+            fprintf(out, ",%s_avg_us,%s_max_us",
+                         timer_names[t], timer_names[t]);
+        fputs(",frame_max_us,instrs_avg,instrs_max,vdp_bytes,rom_bytes", out);
+        for (int i = 0; i < 32; i++) fprintf(out, ",cmd_%02x", i);
+        fputc('\n', out);
+    }
+
+    m->prof = p;
+}
+
+void prof_stop(struct prof *p) {
+    if (!p->machine) return;
+
+    dump(p);
+    if (p->out && p->out != stderr) fclose(p->out);
+
+    p->machine->prof = NULL;
+    p->machine = NULL;
+}
+
+void prof_frame(struct prof *p) {
+    if (!p->machine) return;
+
+    struct prof_frame *cur = &p->cur;
+    uint64_t *c = (uint64_t *)cur, *s = (uint64_t *)&p->sum,
+             *m = (uint64_t *)&p->max, total = 0;
+
+    cur->instrs = p->machine->uxn.icount - p->icount;
+    p->icount   = p->machine->uxn.icount;
+
+    /* H-blank vectors run inside the rasterization timer */
+    if (cur->time[PROF_RASTER] > cur->time[PROF_HBLANK])
+        cur->time[PROF_RASTER] -= cur->time[PROF_HBLANK];
+    else cur->time[PROF_RASTER] = 0;
+
+    uint32_t *h = p->history[p->frame % PROF_HISTORY];
+    for (int t = 0; t < PROF_TIMERS; t++) {
+        total += cur->time[t];
+        h[t] = cur->time[t] > UINT32_MAX ? UINT32_MAX : cur->time[t];
+    }
+    if (total > p->frame_max) p->frame_max = total;
+
+    for (size_t i = 0; i < WORDS; i++) {
+        s[i] += c[i];
+        if (c[i] > m[i]) m[i] = c[i];
+    }
+
+    p->frame++;
+    if (++p->frames >= p->period) dump(p);
+
+    memset(cur, 0, sizeof *cur);
+}
+
+void prof_overlay(struct prof *p, uint32_t *buffer, int width, int height) {
+    if (!p->machine || height < OVERLAY_H) return;
+
+    uint32_t *base = buffer + (height - OVERLAY_H) * width;
+
+    for (int i = 0; i < OVERLAY_H * width; i++)
+        base[i] = base[i] >> 2 & 0x3F3F3F;
+
+    for (int x = 0; x < width; x++) {
+        int64_t frame = (int64_t)p->frame - width + x;
+        if (frame < 0 || (uint64_t)frame + PROF_HISTORY <= p->frame)
+            continue;
+
+        uint32_t *h = p->history[frame % PROF_HISTORY];
+        uint64_t y = 0;
+
+        for (int t = 0; t < PROF_TIMERS; t++) {
+            uint64_t top = y + (uint64_t)h[t] * OVERLAY_H / BUDGET;
+            for (; y < top && y < OVERLAY_H; y++)
+                base[(OVERLAY_H - 1 - y) * width + x] = timer_colors[t];
+        }
+    }
+
+    for (int x = 0; x < width; x += 2) base[x] = 0xFFFFFF;
+}
+
+#undef OVERLAY_H
+#undef BUDGET
+#undef WORDS
\ No newline at end of file
@@ -0,0 +1,81 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "shm.h"
+
+/* ==========================================================================
+   B6X SHARED-MEMORY FRAME EXPORT
+   ========================================================================== */
+
+#define PAGE 4096
+
+int shm_export_open(struct shm *s, const char *name,
+                    uint32_t width, uint32_t height) {
+    size_t offset = (sizeof(struct shm_header) + PAGE - 1) & ~(size_t)(PAGE-1);
+    size_t size   = offset + (size_t)SHM_SLOTS * width * height * 4;
+
+    memset(s, 0, sizeof *s);
+    snprintf(s->name, sizeof s->name, "%s%s", *name == '/' ? "" : "/", name);
+
+    /* Never takes over an object in use, stale ones are removed by hand */
+    int fd = shm_open(s->name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) return -1;
+
+    void *map = MAP_FAILED;
+    if (!ftruncate(fd, size))
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED) { shm_unlink(s->name); return -1; }
+
+    s->header = map;
+    s->size   = size;
+
+    s->header->version = SHM_VERSION;
+    s->header->width   = width;
+    s->header->height  = height;
+    s->header->slots   = SHM_SLOTS;
+    s->header->offset  = offset;
+
+    /* Readers only trust the layout once the magic is there */
+    __atomic_store_n(&s->header->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void shm_export_close(struct shm *s) {
+    if (!s->header) return;
+
+    munmap(s->header, s->size);
+    shm_unlink(s->name);
+    s->header = NULL;
+}
+
+/* Never waits for readers, a slow one sees the slot's lock change */
+void shm_export_frame(struct shm *s, const uint32_t *buffer, uint64_t time_ns) {
+    struct shm_header *h = s->header;
+    if (!h) return;
+
+    uint64_t frame = h->frame + 1;
+    struct shm_slot *slot = &h->slot[(frame - 1) % SHM_SLOTS];
+    size_t pixels = (size_t)h->width * h->height;
+    uint32_t *dst = (uint32_t *)((uint8_t *)h + h->offset) +
+                    (frame - 1) % SHM_SLOTS * pixels;
+
+    __atomic_store_n(&slot->lock, slot->lock + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy(dst, buffer, pixels * sizeof(*buffer));
+    slot->frame   = frame;
+    slot->time_ns = time_ns;
+
+    __atomic_store_n(&slot->lock, slot->lock + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&h->frame, frame, __ATOMIC_RELEASE);
+}
+
+#undef PAGE
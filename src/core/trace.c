@@ -0,0 +1,90 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "prof.h"
+#include "trace.h"
+#include "uxn.h"
+
+/* ==========================================================================
+   B6X EXECUTION TRACE
+   ========================================================================== */
+
+#define VERSION_T 1
+
+int trace_start(struct trace *t, struct uxn *u,
+                uint32_t entries, const char *path) {
+    uint32_t size = 1;
+    while (size < entries && size < (1u << 31)) size <<= 1;
+
+    memset(t, 0, sizeof *t);
+    if (!(t->ring = malloc((size_t)size * sizeof(struct trace_entry))))
+        return -1;
+
+    t->mask  = size - 1;
+    t->path  = path;
+    t->quiet = 1;                     /* - No frame before the first one */
+
+    u->trace = t;
+    return 0;
+}
+
+void trace_stop(struct trace *t, struct uxn *u) {
+    if (u->trace == t) u->trace = NULL;
+
+    free(t->ring);
+    t->ring = NULL;
+}
+
+uint32_t trace_time(void) {
+    return prof_now() / 1000;
+}
+
+/* Frame marker. Frames run ahead are rolled back, only the time between
+   real frames counts; a late one is left for the host to dump */
+void trace_frame(struct trace *t, uint32_t frame, uint8_t speculative) {
+    uint32_t now = trace_time();
+
+    trace_put(t, TRACE_FRAME, speculative, frame, now);
+    if (speculative) return;
+
+    if (t->quiet) t->quiet--;
+    else if (now - t->start > TRACE_LATE_US) t->late = t->on_late;
+
+    t->start = now;
+}
+
+/* Little-endian header and entries, oldest entry first. The dump delays
+   the frames after it, so they are not checked for being late */
+int trace_dump(struct trace *t) {
+    if (!t->ring || !t->path) return -1;
+
+    FILE *out = fopen(t->path, "wb");
+    if (!out) return -1;
+
+    uint64_t count = t->head > t->mask ? (uint64_t)t->mask + 1 : t->head;
+    uint8_t  header[20] = { 'B', '6', 'X', 'T', VERSION_T, 0,
+                            sizeof(struct trace_entry), 0 };
+
+    for (uint8_t i = 0; i < 4; i++) header[8 + i]  = count >> (i << 3);
+    for (uint8_t i = 0; i < 8; i++) header[12 + i] = t->head >> (i << 3);
+    fwrite(header, sizeof header, 1, out);
+
+    for (uint64_t i = t->head - count; i != t->head; i++) {
+        struct trace_entry *e = &t->ring[i & t->mask];
+        uint8_t b[8] = { e->kind, e->op, e->addr, e->addr >> 8,
+                         e->data, e->data >> 8, e->data >> 16, e->data >> 24 };
+        fwrite(b, sizeof b, 1, out);
+    }
+
+    t->late  = 0;
+    t->quiet = TRACE_QUIET;
+
+    int failed = ferror(out);
+    if (fclose(out) || failed) return -1;
+
+    return 0;
+}
+
+#undef VERSION_T
@@ -0,0 +1,285 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dev.h"
+#include "uxn.h"
+
+/* ==========================================================================
+   B6X ARITHMETIC COPROCESSOR
+   ========================================================================== */
+
+#define ITERATIONS 24         /* - CORDIC steps, enough for 16.16 results */
+#define GAIN       0x26DD3B6A /* - 1/CORDIC gain, as 2.30 fixed point     */
+
+/* atan(2^-i) in binary angle units, 2^32 per turn */
+static const uint32_t atan_table[ITERATIONS] = {
+    0x20000000, 0x12e4051e, 0x09fb385b, 0x051111d4, 0x028b0d43, 0x0145d7e1,
+    0x00a2f61e, 0x00517c55, 0x0028be53, 0x00145f2f, 0x000a2f98, 0x000517cc,
+    0x00028be6, 0x000145f3, 0x0000a2fa, 0x0000517d, 0x000028be, 0x0000145f,
+    0x00000a30, 0x00000518, 0x0000028c, 0x00000146, 0x000000a3, 0x00000051
+};
+
+static uint32_t peek4(uint8_t *ram, uint16_t addr) {
+    return (uint32_t)PEEK2(addr, ram, 0xFFFF) << 16 |
+                     PEEK2(addr + 2, ram, 0xFFFF);
+}
+
+static void poke4(uint8_t *ram, uint16_t addr, uint32_t value) {
+    POKE2(addr, ram, 0xFFFF, value >> 16);
+    POKE2(addr + 2, ram, 0xFFFF, value);
+}
+
+static int32_t fmul(int32_t a, int32_t b) {
+    return (int64_t)a * b >> 16;
+}
+
+static uint64_t isqrt(uint64_t v) {
+    uint64_t root = 0, bit = (uint64_t)1 << 62;
+
+    while (bit > v) bit >>= 2;
+    while (bit) {
+        if (v >= root + bit) { v -= root + bit; root = (root >> 1) + bit; }
+        else root >>= 1;
+        bit >>= 2;
+    }
+
+    return root;
+}
+
+/* === RAM access wrapping at the end of RAM, like the rest of the system === */
+static void ram_read(const uint8_t *ram, uint16_t addr, uint8_t *buf,
+                                                         uint32_t n) {
+    for (uint32_t a; n; buf += a, n -= a, addr = 0) {
+        a = 65536u - addr > n ? n : 65536u - addr;
+        memcpy(buf, ram + addr, a);
+    }
+}
+
+static void ram_write(uint8_t *ram, uint16_t addr, const uint8_t *buf,
+                                                    uint32_t n) {
+    for (uint32_t a; n; buf += a, n -= a, addr = 0) {
+        a = 65536u - addr > n ? n : 65536u - addr;
+        memcpy(ram + addr, buf, a);
+    }
+}
+
+static void ram_fill(uint8_t *ram, uint16_t addr, uint8_t value, uint32_t n) {
+    for (uint32_t a; n; n -= a, addr = 0) {
+        a = 65536u - addr > n ? n : 65536u - addr;
+        memset(ram + addr, value, a);
+    }
+}
+
+/* memmove for RAM, in pieces that don't cross its end. Forward is safe
+   unless dst is less than n bytes after src, backward unless src is less
+   than n bytes after dst; copies over 32 KB can hit both. Returns 0 if
+   the scratch buffer for those can't be allocated. */
+static uint32_t ram_move(uint8_t *ram, uint16_t dst, uint16_t src,
+                                                       uint32_t n) {
+    uint16_t d = dst - src;
+    uint32_t moved = n;
+
+    if (!d || !n) return moved;
+
+    if (d >= n) for (uint32_t a; n; n -= a, src += a, dst += a) {
+        a = n;
+        if (a > 65536u - src) a = 65536u - src;
+        if (a > 65536u - dst) a = 65536u - dst;
+        memmove(ram + dst, ram + src, a);
+    }
+    else if (65536u - d >= n) for (uint32_t a; n; n -= a) {
+        uint32_t s = (uint16_t)(src + n - 1) + 1u,
+                 t = (uint16_t)(dst + n - 1) + 1u;
+
+        a = n;
+        if (a > s) a = s;
+        if (a > t) a = t;
+        memmove(ram + t - a, ram + s - a, a);
+    }
+    else {
+        uint8_t *buffer = malloc(n);
+        if (!buffer) return 0;
+
+        ram_read(ram, src, buffer, n);
+        ram_write(ram, dst, buffer, n);
+        free(buffer);
+    }
+
+    return moved;
+}
+
+/* Spans of len bytes from a and b, shorter than RAM, share a byte */
+static int ram_overlap(uint16_t a, uint32_t alen, uint16_t b, uint32_t blen) {
+    if (alen >= 65536 || blen >= 65536) return alen && blen;
+    return (alen && (uint16_t)(b - a) < alen) ||
+           (blen && (uint16_t)(a - b) < blen);
+}
+
+/* Rows are copied from a snapshot of RAM taken before any row is written,
+   which holds the whole source however large the block is. Returns 0 if
+   the snapshot can't be allocated. */
+static int blit_buffered(uint8_t *ram, const uint16_t *w) {
+    uint8_t *snapshot = malloc(65536);
+    if (!snapshot) return 0;
+
+    memcpy(snapshot, ram, 65536);
+    for (uint32_t row = 0; row < w[3]; row++) {
+        uint16_t src = w[0] + row * w[4];
+        uint32_t a = 65536u - src > w[2] ? w[2] : 65536u - src;
+
+        ram_write(ram, w[1] + row * w[5], snapshot + src, a);
+        ram_write(ram, w[1] + row * w[5] + a, snapshot, w[2] - a);
+    }
+
+    free(snapshot);
+    return 1;
+}
+
+/* Operands are 16-bit words after the operation number. Overlapping blocks
+   move as if all of the source was read before anything is written. */
+static uint32_t dma(uint8_t *ram, uint8_t op, uint16_t block) {
+    uint16_t w[6];
+
+    for (uint8_t i = 0; i < 6; i++)
+        w[i] = PEEK2(block + 1 + i * 2, ram, 0xFFFF);
+
+    /* BLIT spans from the first byte of the first row to the last one */
+    uint32_t src_span = w[3] ? (w[3] - 1u) * w[4] + w[2] : 0,
+             dst_span = w[3] ? (w[3] - 1u) * w[5] + w[2] : 0;
+
+    switch (op) {
+        case 0x10: return ram_move(ram, w[1], w[0], w[2]);       /* COPY */
+        case 0x11: ram_fill(ram, w[0], w[2], w[1]);              /* FILL */
+                   return w[1];
+        case 0x12: if (!w[2] || !w[3]) return 0;                 /* BLIT */
+
+                   if (ram_overlap(w[0], src_span, w[1], dst_span)) {
+                       if (!blit_buffered(ram, w)) return 0;
+                   }
+                   else for (uint32_t row = 0; row < w[3]; row++)
+                       ram_move(ram, w[1] + row * w[5],
+                                     w[0] + row * w[4], w[2]);
+                   return (uint32_t)w[2] * w[3];
+        case 0x13: for (uint32_t row = 0; row < w[2]; row++)     /* RECT */
+                       ram_fill(ram, w[0] + row * w[3], w[4], w[1]);
+                   return (uint32_t)w[1] * w[2];
+    }
+
+    return 0;
+}
+
+/* Integer CORDIC keeps results identical on every host */
+static void cordic_sincos(uint32_t angle, int32_t *s, int32_t *c) {
+    int64_t x = GAIN, y = 0;
+    int32_t z;
+    uint8_t flip = 0;
+
+    /* Rotate by half a turn into -1/4..1/4, where CORDIC converges */
+    if (angle + 0x40000000u >= 0x80000000u) {
+        angle += 0x80000000u;
+        flip = 1;
+    }
+    z = (int32_t)angle;
+
+    for (uint8_t i = 0; i < ITERATIONS; i++) {
+        int64_t dx = y >> i, dy = x >> i;
+
+        if (z >= 0) { x -= dx; y += dy; z -= atan_table[i]; }
+        else        { x += dx; y -= dy; z += atan_table[i]; }
+    }
+
+    x = (x + (1 << 13)) >> 14;
+    y = (y + (1 << 13)) >> 14;
+
+    *c = flip ? -x : x;
+    *s = flip ? -y : y;
+}
+
+static uint32_t cordic_atan2(int32_t y0, int32_t x0) {
+    int64_t x = x0 * (int64_t)(1 << 24), y = y0 * (int64_t)(1 << 24);
+    uint32_t z = 0;
+
+    if (!x0 && !y0) return 0;
+    if (x < 0) { x = -x; y = -y; z = 0x80000000u; }
+
+    for (uint8_t i = 0; i < ITERATIONS; i++) {
+        int64_t dx = y >> i, dy = x >> i;
+
+        if (y > 0) { x += dx; y -= dy; z += atan_table[i]; }
+        else       { x -= dx; y += dy; z -= atan_table[i]; }
+    }
+
+    return (z + 0x8000) >> 16 & 0xFFFF;
+}
+
+void dev_cop_deo(struct uxn *u, uint8_t *port) {
+    struct cop *cop = &B6X(u)->cop;
+    uint8_t *ram = u->ram;
+    port--;
+
+    uint16_t block = PEEK2(0, port, 1);
+    uint8_t  op    = ram[block];
+    uint32_t r0 = 0, r1 = 0;
+
+    if (op >= 0x10) { r0 = dma(ram, op, block); goto done; }
+
+    int32_t  a = peek4(ram, block + 1),  b = peek4(ram, block + 5),
+             c = peek4(ram, block + 9),  d = peek4(ram, block + 13);
+    int32_t  sin, cos;
+
+    /* Vector operands: RAM addresses of c 32-bit words */
+    uint16_t va = a, vb = b, n = c;
+
+    switch (op) {
+        case 0x00: { int64_t p = (int64_t)a * b;
+                     r0 = (uint64_t)p >> 32; r1 = p; break; }
+        case 0x01: if (b) r0 = (int64_t)a / b, r1 = (int64_t)a % b; break;
+        case 0x02: if (b) r0 = (uint32_t)a / (uint32_t)b,
+                          r1 = (uint32_t)a % (uint32_t)b; break;
+        case 0x03: r0 = fmul(a, b); break;
+        case 0x04: if (b) r0 = (int64_t)a * 65536 / b; break;
+        case 0x05: r0 = c + fmul(a, b); break;
+        case 0x06: r0 = isqrt((uint32_t)a);
+                   r1 = isqrt((uint64_t)(uint32_t)a << 16); break;
+        case 0x07: r0 = cordic_atan2(a, b);
+                   r1 = isqrt((uint64_t)((int64_t)a * a) +
+                              (uint64_t)((int64_t)b * b)); break;
+        case 0x08: cordic_sincos((uint32_t)a << 16, &sin, &cos);
+                   r0 = sin; r1 = cos; break;
+
+        case 0x09: for (uint16_t i = 0; i < n; i++, va += 4, vb += 4)
+                       r0 += fmul(peek4(ram, va), peek4(ram, vb));
+                   break;
+        case 0x0A: for (uint16_t i = 0; i < n; i++, va += 4, vb += 4)
+                       poke4(ram, va, peek4(ram, va) +
+                                      fmul(peek4(ram, vb), d));
+                   break;
+        case 0x0B: for (uint16_t i = 0; i < n; i++, va += 4, vb += 4)
+                       poke4(ram, va, fmul(peek4(ram, vb), d));
+                   break;
+
+        default: break;
+    }
+
+done:
+    for (uint8_t i = 0; i < 4; i++) {
+        cop->result[i]     = r0 >> ((3 - i) << 3);
+        cop->result[i + 4] = r1 >> ((3 - i) << 3);
+    }
+    cop->pos = 0;
+}
+
+/* DEI2 reads the results a word at a time, high word first */
+uint8_t dev_cop_dei(struct uxn *u, uint8_t *port) {
+    struct cop *cop = &B6X(u)->cop;
+
+    if (port == u->dev) return *port = cop->result[cop->pos & 7];
+
+    *port = cop->result[(cop->pos + 1) & 7];
+    cop->pos += 2;
+    return *port;
+}
+
+#undef ITERATIONS
+#undef GAIN
@@ -1,24 +1,33 @@
-#include <stdint.h>
-
-#include "uxn.h"
-#include "dev.h"
-
-/* ==========================================================================
-   B6X CONTROLLER
-   ========================================================================== */
-
-static uint8_t  ctl_btn = 0;
-static uint16_t ctl_vec = 0;
-
-uint8_t dev_ctl_dei(uint8_t *port) {
-    return *port = ctl_btn;
-}
-void dev_ctl_deo(uint8_t *port) {
-    port--;
-    ctl_vec = PEEK2(0, port, 1);
-}
-
-void dev_ctl(uint8_t code) {
-    ctl_btn = code;
-    if (ctl_vec) uxn_eval(ctl_vec);
+#include <stdint.h>
+
+#include "uxn.h"
+#include "dev.h"
+
+/* ==========================================================================
+   B6X CONTROLLER
+   ========================================================================== */
+
+uint8_t dev_ctl_dei(struct uxn *u, uint8_t *port) {
+    return *port = B6X(u)->ctl.btn;
+}
+void dev_ctl_deo(struct uxn *u, uint8_t *port) {
+    port--;
+    B6X(u)->ctl.vec = PEEK2(0, port, 1);
+}
+
+/* Events are queued and delivered by dev_ctl_flush, once per frame */
+void dev_ctl(struct b6x *m, uint8_t code) {
+    struct ctl *ctl = &m->ctl;
+
+    if (ctl->tail - ctl->head >= CTL_QUEUE) return;
+    ctl->queue[ctl->tail++ & (CTL_QUEUE - 1)] = code;
+}
+
+void dev_ctl_flush(struct b6x *m) {
+    struct ctl *ctl = &m->ctl;
+
+    while (ctl->head != ctl->tail) {
+        ctl->btn = ctl->queue[ctl->head++ & (CTL_QUEUE - 1)];
+        if (ctl->vec) uxn_eval(&m->uxn, ctl->vec);
+    }
 }
\ No newline at end of file
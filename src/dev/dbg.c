@@ -1,31 +1,50 @@
-#include <stdint.h>
-#include <stdio.h>
-
-#include "uxn.h"
-#include "dev.h"
-
-/* ==========================================================================
-   B6X DEBUG INTERFACE
-   ========================================================================== */
-
-static void stack_printer(char *name, uint8_t ptr, uint8_t *stk) {
-	fprintf(stderr, "%s%c", name, ptr - 8 ? ' ' : '|');
-	for(uint8_t i = ptr - 8; i != ptr; i++)
-		fprintf(stderr, "%02x%c", stk[i], i == 0xff ? '|' : ' ');
-	fprintf(stderr, "<%02x\n", ptr);
-}
-
-uint8_t dev_dbg_dei(uint8_t *port) {
-    return 0;
-}
-
-void dev_dbg_deo(uint8_t *port) {
-    switch (*port) {
-        case 0: return;
-        case 1: stack_printer("WST", uxn_ptr[0], &uxn_stk[0][0]);
-                stack_printer("RST", uxn_ptr[1], &uxn_stk[1][0]); return;
-        case 2: getchar(); return;
-
-        default: return;
-    }
+#include <stdint.h>
+#include <stdio.h>
+
+#include "uxn.h"
+#include "dev.h"
+#include "trace.h"
+
+/* ==========================================================================
+   B6X DEBUG INTERFACE
+   ========================================================================== */
+
+static void stack_printer(char *name, uint8_t ptr, uint8_t *stk) {
+	fprintf(stderr, "%s%c", name, ptr - 8 ? ' ' : '|');
+	for(uint8_t i = ptr - 8; i != ptr; i++)
+		fprintf(stderr, "%02x%c", stk[i], i == 0xff ? '|' : ' ');
+	fprintf(stderr, "<%02x\n", ptr);
+}
+
+static void counter_select(struct dbg *dbg, uint32_t value) {
+    dbg->counter = value;
+    dbg->counter_byte = 0;
+}
+
+uint8_t dev_dbg_dei(struct uxn *u, uint8_t *port) {
+    struct dbg *dbg = &B6X(u)->dbg;
+    return *port = dbg->counter >> ((3 - (dbg->counter_byte++ & 3)) << 3);
+}
+
+void dev_dbg_deo(struct uxn *u, uint8_t *port) {
+    struct b6x *m = B6X(u);
+
+    switch (*port) {
+        case 0: return;
+        case 1: stack_printer("WST", u->ptr[0], &u->stk[0][0]);
+                stack_printer("RST", u->ptr[1], &u->stk[1][0]); return;
+        case 2: getchar(); return;
+        case 3: m->dbg.icount_base = u->icount; return;
+        case 4: if (u->trace && trace_dump(u->trace))
+                    fprintf(stderr, "Trace dump failed\n");
+                return;
+
+        case 0x10: counter_select(&m->dbg, u->icount - m->dbg.icount_base);
+                   return;
+        case 0x11: counter_select(&m->dbg, u->icount - u->vstart); return;
+        case 0x12: counter_select(&m->dbg, m->vdp.frame);          return;
+        case 0x13: counter_select(&m->dbg, m->vdp.line);           return;
+
+        default: return;
+    }
 }
\ No newline at end of file
@@ -1,29 +1,75 @@
-#include <stdint.h>
-
-#include "dev.h"
-#include "uxn.h"
-
-/* ==========================================================================
-   B6X DEVICE I/O HANDLING
-   ========================================================================== */
-
-void dev_init(void) {
-    uxn_dei_handlers[0x04] = dev_wst_dei;
-    uxn_deo_handlers[0x04] = dev_wst_deo;
-
-	uxn_dei_handlers[0x05] = dev_rst_dei;
-	uxn_deo_handlers[0x05] = dev_rst_deo;
-
-    uxn_deo_handlers[0x07] = dev_meta_deo;
-
-    uxn_deo_handlers[0x09] = dev_rom_deo;
-
-    uxn_dei_handlers[0x0A] = dev_ctl_dei;
-    uxn_deo_handlers[0x0B] = dev_ctl_deo;
-
-    uxn_dei_handlers[0x0C] = dev_vdp_dei;
-    uxn_deo_handlers[0x0D] = dev_vdp_deo;
-
-    uxn_dei_handlers[0x0E] = dev_dbg_dei;
-    uxn_deo_handlers[0x0E] = dev_dbg_deo;
+#include <stdint.h>
+#include <string.h>
+
+#include "dev.h"
+#include "uxn.h"
+
+/* ==========================================================================
+   B6X DEVICE I/O HANDLING
+   ========================================================================== */
+
+void dev_init(struct b6x *m) {
+    struct uxn *u = &m->uxn;
+
+    u->dei_handlers[0x00] = dev_cop_dei;
+    u->dei_handlers[0x01] = dev_cop_dei;
+    u->deo_handlers[0x01] = dev_cop_deo;
+
+    u->dei_handlers[0x04] = dev_wst_dei;
+    u->deo_handlers[0x04] = dev_wst_deo;
+
+	u->dei_handlers[0x05] = dev_rst_dei;
+	u->deo_handlers[0x05] = dev_rst_deo;
+
+    u->deo_handlers[0x07] = dev_meta_deo;
+
+    u->dei_handlers[0x08] = dev_rom_dei;
+    u->deo_handlers[0x09] = dev_rom_deo;
+
+    u->dei_handlers[0x0A] = dev_ctl_dei;
+    u->deo_handlers[0x0B] = dev_ctl_deo;
+
+    u->dei_handlers[0x0C] = dev_vdp_dei;
+    u->deo_handlers[0x0D] = dev_vdp_deo;
+
+    u->dei_handlers[0x0E] = dev_dbg_dei;
+    u->deo_handlers[0x0E] = dev_dbg_deo;
+
+    m->vdp.line = 224;
+
+#ifdef B6X_AOT
+    u->native = aot_eval;
+#endif
+}
+
+/* Run one frame hidden, then run ahead of it and present the last frame.
+   The machine is restored from state afterwards, so it advances by one
+   frame and the frames run ahead are discarded. */
+static void runahead(struct b6x *m, struct b6x *state, uint8_t frames,
+                     uint32_t *buffer, uint8_t *index, uint16_t *palette) {
+    uint8_t ahead = frames;
+
+    if (ahead) {
+        dev_vdp(m, NULL);
+        memcpy(state, m, sizeof(*m));
+
+        /* Cleared again by the restore */
+        m->vdp.speculative = 1;
+        while (--frames) dev_vdp(m, NULL);
+    }
+
+    if (index) dev_vdp_indexed(m, index, palette);
+    else       dev_vdp(m, buffer);
+
+    if (ahead) memcpy(m, state, sizeof(*m));
+}
+
+void dev_runahead(struct b6x *m, struct b6x *state,
+                  uint32_t *buffer, uint8_t frames) {
+    runahead(m, state, frames, buffer, NULL, NULL);
+}
+
+void dev_runahead_indexed(struct b6x *m, struct b6x *state,
+                          uint8_t *index, uint16_t *palette, uint8_t frames) {
+    runahead(m, state, frames, NULL, index, palette);
 }
\ No newline at end of file
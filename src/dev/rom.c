@@ -1,66 +1,150 @@
-#include <stdint.h>
-#include <stdio.h>
-#include <stddef.h>
-
-#include "dev.h"
-#include "uxn.h"
-
-/* ==========================================================================
-   B6X READ ONLY MEMORY
-   ========================================================================== */
-
-static FILE  *rom      = NULL;
-static size_t rom_size = 0;
-
-void dev_rom_deo(uint8_t *port) {
-    if (!rom) return;
-    port--;
-
-    static uint8_t step = 0;
-    static size_t src = 0;
-    static size_t dst = 0;
-    static size_t num = 0;
-
-    switch (step++) {
-        case 0: src = PEEK2(0, port, 1); return;
-        case 1: dst = PEEK2(0, port, 1); return;
-        case 2: {
-            num = PEEK2(0, port, 1);
-            src = (src << 8) % rom_size; /* Convert pages to bytes */
-
-            while (num) {
-                size_t avail = 65536 - dst;
-                if (avail > rom_size - src) avail = rom_size - src;
-                if (avail > num) avail = num;
-
-                fseek(rom, src, SEEK_SET);
-                fread(uxn_ram + dst, avail, 1, rom);
-
-                dst = (dst + avail) & 65535;
-                src = (src + avail) % rom_size;
-                num -= avail;
-            }
-
-            step = 0;
-            return;
-        }
-    }
-}
-
-void dev_rom_open(const char *fname) {
-    dev_rom_close();
-    if (!(rom = fopen(fname, "rb"))) return;
-
-    fseek(rom, 0, SEEK_END);
-    rom_size = ftell(rom) + 1;
-    fseek(rom, 0, SEEK_SET);
-}
-
-void dev_rom_close(void) {
-    if (!rom) return;
-
-    fclose(rom);
-    rom = NULL;
-}
-
-
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "dev.h"
+#include "prof.h"
+#include "uxn.h"
+
+/* ==========================================================================
+   B6X READ ONLY MEMORY
+   ========================================================================== */
+
+void dev_rom_read(struct b6x *m, uint8_t *mem, size_t addr, size_t size,
+                                              uint16_t page, size_t num) {
+    struct rom *rom = &m->rom;
+    if (!rom->data) return;
+
+    PROF_ADD(m, rom_bytes, num);
+
+    size_t src = ((size_t)page << 8) % rom->size; /* Convert pages to bytes */
+    addr %= size;
+
+    while (num) {
+        size_t avail = size - addr;
+        if (avail > rom->size - src) avail = rom->size - src;
+        if (avail > num) avail = num;
+
+        memcpy(mem + addr, rom->data + src, avail);
+
+        addr = (addr + avail) % size;
+        src  = (src + avail) % rom->size;
+        num -= avail;
+    }
+}
+
+static void rom_bank(struct uxn *u, uint16_t bank) {
+    struct rom *rom = &B6X(u)->rom;
+
+    size_t src = ((size_t)bank << 8) % rom->size;
+    size_t avail = rom->size - src;
+
+    rom->bank   = bank;
+    u->win      = rom->data + src;
+    u->win_size = avail < u->win_span ? avail : u->win_span;
+}
+
+/* Reading the port enables the window reserved by the header, showing the
+   current bank; from then on stores to the window select banks instead of
+   writing RAM. Returns the page count of the window, 0 without one. */
+uint8_t dev_rom_dei(struct uxn *u, uint8_t *port) {
+    struct rom *rom = &B6X(u)->rom;
+    if (!rom->data || !rom->win_span) return 0;
+
+    u->win_base  = rom->win_base;
+    u->win_span  = rom->win_span;
+    u->win_store = dev_rom_window;
+
+    rom_bank(u, rom->bank);
+    return rom->win_span >> 8;
+}
+
+void dev_rom_deo(struct uxn *u, uint8_t *port) {
+    struct rom *rom = &B6X(u)->rom;
+    if (!rom->data) return;
+    port--;
+
+    switch (rom->step++) {
+        case 0: rom->src = PEEK2(0, port, 1); return;
+        case 1: rom->dst = PEEK2(0, port, 1); return;
+        case 2: dev_rom_read(B6X(u), u->ram, rom->dst, 65536,
+                                     rom->src, PEEK2(0, port, 1));
+                rom->step = 0;
+                return;
+    }
+}
+
+/* Every byte stored to the window shifts into the bank register, so a
+   short store selects a bank; the window then shows the ROM from there */
+void dev_rom_window(struct uxn *u, uint16_t addr, uint8_t value) {
+    struct rom *rom = &B6X(u)->rom;
+    if (!rom->data) return;
+
+    rom_bank(u, rom->bank << 8 | value);
+}
+
+uint8_t *dev_rom_load(const char *fname, size_t *size) {
+    FILE *file = fopen(fname, "rb");
+    if (!file) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    uint8_t *data = length > 0 ? malloc(length) : NULL;
+    if (data && fread(data, length, 1, file) != 1) {
+        free(data);
+        data = NULL;
+    }
+
+    fclose(file);
+    *size = data ? length : 0;
+    return data;
+}
+
+void dev_rom_attach(struct b6x *m, const uint8_t *data, size_t size) {
+    dev_rom_close(m);
+
+    m->rom.data = data;
+    m->rom.size = size;
+
+    /* Header 0x80: first RAM page of the window, 0x81: its page count.
+       It stays off until the ROM reads the port, so the
+       BIOS and everything before that work with the RAM underneath */
+    if (size < 0x100 || !data[0x81]) return;
+
+    uint16_t pages = data[0x81];
+    if (pages > 0x100 - data[0x80]) pages = 0x100 - data[0x80];
+
+    m->rom.win_base = data[0x80] << 8;
+    m->rom.win_span = pages << 8;
+}
+
+void dev_rom_open(struct b6x *m, const char *fname) {
+    size_t size;
+    uint8_t *data = dev_rom_load(fname, &size);
+
+    dev_rom_attach(m, data, size);
+    m->rom.owned = data;
+}
+
+void dev_rom_close(struct b6x *m) {
+    free(m->rom.owned);
+
+    m->rom.data  = NULL;
+    m->rom.owned = NULL;
+    m->rom.size  = 0;
+    m->rom.step  = 0;
+    m->rom.bank  = 0;
+
+    m->rom.win_base = 0;
+    m->rom.win_span = 0;
+
+    m->uxn.win       = NULL;
+    m->uxn.win_size  = 0;
+    m->uxn.win_span  = 0;
+    m->uxn.win_store = NULL;
+}
+
@@ -1,344 +1,608 @@
-#include <stdint.h>
-#include <stdio.h>
-#include <string.h>
-
-#include "dev.h"
-#include "uxn.h"
-
-/* ==========================================================================
-   B6X VIDEO DISPLAY PROCESSOR
-   ========================================================================== */
-
-static uint16_t regs[16],    cram[64];
-static uint8_t  vram[65536], cgram[1024];
-
-#define W 320 /* - Screen width  */
-#define H 224 /* - Screen height */
-
-/* === MODE Register fields === */
-#define F_TXTBUF  0b0000000000000001 /* - Show text buffer                */
-#define F_SPRITES 0b0000000000000010 /* - Show sprites                    */
-#define F_PLANE_A 0b0000000000000100 /* - Show tile layer A               */
-#define F_PLANE_B 0b0000000000001000 /* - Show tile layer B               */
-#define F_BG_COL  0b0000000000110000 /* - Palette row of background color */
-#define F_HBLANK  0b0000000001000000 /* - Enable H-blank vector           */
-#define F_VBLANK  0b0000000010000000 /* - Enable V-blank vector           */
-
-#define F_REGS_W  0b0001000000000000 /* - Register write indicator        */
-#define F_VRAM_W  0b0010000000000000 /* - VRAM write indicator            */
-#define F_CRAM_W  0b0100000000000000 /* - CRAM write indicator            */
-#define F_CGRAM_W 0b1000000000000000 /* - CGRAM write indicator           */
-
-/* === Register aliases === */
-#define COMMAND   regs[0x0]  /* - Command of DEO/DEI operation            */
-#define MODE      regs[0x1]  /* - VDP mode and indicators                 */
-
-#define USER_A    regs[0x2]  /* - User register A                         */
-#define USER_B    regs[0x3]  /* - User register B                         */
-#define USER_C    regs[0x4]  /* - User register C                         */
-
-#define HBLANK    regs[0x5]  /* - H-blank vector location in RAM          */
-#define HBLANK_Y  regs[0x6]  /* - H-blank vector trigger line             */
-#define VBLANK    regs[0x7]  /* - V-blank vector location in RAM          */
-
-#define TXTBUF    regs[0x8]  /* - Text buffer location in VRAM            */
-#define SPRITES   regs[0x9]  /* - Sprite attribute table location in VRAM */
-
-#define PLANE_A   regs[0xA]  /* - Tile layer A location in VRAM           */
-#define PLANE_A_X regs[0xB]  /* - Layer A horizontal scroll               */
-#define PLANE_A_Y regs[0xC]  /* - Layer A vertical scroll                 */
-
-#define PLANE_B   regs[0xD]  /* - Tile layer B location in VRAM           */
-#define PLANE_B_X regs[0xE]  /* - Layer B horizontal scroll               */
-#define PLANE_B_Y regs[0xF]  /* - Layer B vertical scroll                 */
-
-static void circ_fill(void *d, size_t i, size_t s,
-                                        uint8_t c, size_t n) {
-    if (n >= s) { memset(d, c, s); return; }
-
-    i %= s;
-
-    while (n) {
-        size_t a = (a = s - i) > n ? n : a;
-        memset(d+i, c, a);
-        i = (i + a) % s;
-        n -= a;
-    }
-}
-
-static void circ_copy(void *d, size_t di, size_t ds,
-                      void *s, size_t si, size_t ss, size_t n) {
-    di %= ds; si %= ss;
-
-    while (n) {
-        size_t a = ds - di;
-        if (a > ss - si) a = ss - si;
-        if (a > n) a = n;
-        memcpy(d+di, s+si, a);
-        di = (di + a) % ds;
-        si = (si + a) % ss;
-        n -= a;
-    }
-}
-
-void dev_vdp_deo(uint8_t *port) {
-    port--;
-
-    if (!COMMAND) { COMMAND = PEEK2(0, port, 1); return; }
-
-    uint8_t parameter = COMMAND >> 8;
-
-    /* printf("VDP %04x %04x\n", PEEK2(0, port, 1), COMMAND); */
-
-    switch (COMMAND & 31) {
-        /* === Register access === */
-        case 0x00: regs[parameter & 15] = 0; break;
-        case 0x01:
-        case 0x02: regs[parameter & 15] = port[COMMAND & 1]; break;
-        case 0x03: regs[parameter & 15] = PEEK2(0, port, 1); break;
-
-        /* === Palette access === */
-        case 0x04: cram[parameter & 63] = 0; break;
-        case 0x05:
-        case 0x06: cram[parameter & 63] = port[COMMAND & 1]; break;
-        case 0x07: cram[parameter & 63] = PEEK2(0, port, 1); break;
-
-        /* === VRAM access 1 === */
-        case 0x08: vram[PEEK2(0, port, 1)] = 0; break;
-        case 0x09:
-        case 0x0A: vram[regs[parameter & 15]] = port[COMMAND & 1]; break;
-        case 0x0B: circ_copy(vram, regs[parameter & 15], 65536,
-                          uxn_ram, regs[parameter >> 4], 65536,
-                                            PEEK2(0, port, 1)); break;
-
-        /* === VRAM access 2 === */
-        case 0x0C: circ_fill(vram, regs[parameter & 15], 65536,
-                                0, PEEK2(0, port, 1)); break;
-        case 0x0D:
-        case 0x0E: circ_fill(vram, regs[parameter & 15], 65536,
-                port[COMMAND & 1], regs[parameter >> 4]); break;
-        case 0x0F: circ_copy(vram, regs[parameter & 15], 65536,
-                       port, 0, 2, regs[parameter >> 4]); break;
-
-        /* === CGRAM Font setting === */
-        case 0x10: circ_copy(cgram, 0, 1024,
-                uxn_ram, PEEK2(0, port, 1), 65536, 1024); break;
-
-        default: break;
-    }
-
-    MODE |= (uint16_t[]) { F_REGS_W, F_CRAM_W, F_VRAM_W, F_VRAM_W,
-                           F_CGRAM_W, 0, 0, 0 }[COMMAND >> 4 & 8];
-    COMMAND = 0;
-}
-
-
-uint8_t dev_vdp_dei(uint8_t *port) {
-    uint8_t  parameter = COMMAND >> 8;
-    uint16_t data = 0;
-
-    switch (COMMAND & 15) {
-        case 0x00: data = regs[parameter & 15]; break;
-        case 0x01: data = cram[parameter & 63]; break;
-        case 0x02: data = PEEK2(regs[parameter & 15], vram, 0xFFFF); break;
-    }
-
-    POKE2(0, port, 1, data);
-    COMMAND = 0;
-
-    return *port;
-}
-
-#define PLANE_GET_PX(plane, plane_x, plane_y, plane_pixels)        \
-    do {                                                           \
-        uint16_t scrolled_x = x + (plane_x),                       \
-                 scrolled_y = y + (plane_y);                       \
-                                                                   \
-        uint8_t column = scrolled_x >> 3 & 63,                     \
-                row    = scrolled_y >> 3 & 31;                     \
-                                                                   \
-        uint16_t addr  = (plane) + (column << 1) + (row << 7),     \
-                 entry = PEEK2(addr, vram, 0xFFFF);                \
-                                                                   \
-        uint16_t pattern_id = entry & 2047;                        \
-                                                                   \
-        if (!pattern_id) break;                                    \
-                                                                   \
-        local_x = scrolled_x & 7, local_y = scrolled_y & 7;        \
-                                                                   \
-        if (entry & 2048) local_x = 7 - local_x;                   \
-        if (entry & 4096) local_y = 7 - local_y;                   \
-                                                                   \
-        addr = (pattern_id << 5) + (local_y << 2) + (local_x >> 1);\
-                                                                   \
-        uint8_t pixel = vram[addr] >> ((~local_x & 1) << 2) & 15;  \
-                                                                   \
-        if (!pixel) break;                                         \
-                                                                   \
-        pixel |= entry >> 9 & F_BG_COL;                            \
-                                                                   \
-        if (entry & 32768) plane_pixels |= pixel << 8;             \
-        else               plane_pixels  = pixel;                  \
-                                                                   \
-    } while (0);
-
-void dev_vdp(uint32_t *buffer) {
-    uint32_t i, x, y = 0;
-    uint8_t color = 0;
-
-    uint16_t sprite_cache[128] = { 0 };
-    uint32_t cram_cache[64]    = { 0 };
-
-    if (MODE & F_VBLANK) uxn_eval(VBLANK);
-
-    if (!(MODE & 0xF000)) return;
-
-    MODE |= F_CRAM_W;
-
-    for (i = 0; i < (W * H); i++) {
-        y = i / W, x = i - y * W;
-
-        if (x) goto not_hblank;
-
-        uint16_t link = SPRITES, idx = 0;
-        sprite_cache[0] = 0;
-
-        while ((MODE & F_SPRITES) && idx != 80*4) {
-            uint16_t base1 = PEEK2(link,     vram, 0xFFFF),
-                     base2 = PEEK2(link + 2, vram, 0xFFFF),
-                     x_pos = PEEK2(link + 4, vram, 0xFFFF) & 511,
-                     y_pos = PEEK2(link + 6, vram, 0xFFFF) & 255;
-
-            if (!(base1 & 2047)) goto skip;
-
-            uint8_t hsize = ((base2 >> 8  & 3) + 1) << 3,
-                    vsize = ((base2 >> 10 & 3) + 1) << 3;
-
-            if (x_pos >= 320 && x_pos < (512 - hsize)) goto skip;
-
-            uint8_t v_dist = y - y_pos;
-            if (v_dist >= vsize) goto skip;
-
-            sprite_cache[idx++ & 127] = base1;
-            sprite_cache[idx++ & 127] = base2;
-            sprite_cache[idx++ & 127] = x_pos;
-            sprite_cache[idx++ & 127] = y_pos;
-
-            if ((idx >> 2) < 32) sprite_cache[idx & 127] = 0;
-
-            skip:
-            if (link == ((base2 & 127) << 3) + SPRITES) break;
-            link = (base2 & 127) << 3;
-            link += SPRITES;
-        }
-
-        if ((MODE & F_HBLANK) && y == HBLANK_Y) uxn_eval(HBLANK);
-
-        for (uint8_t idx = 0; (MODE & F_CRAM_W) && idx < 64; idx++) {
-            uint16_t c = cram[idx];
-            cram_cache[idx] = (c & 0xF00) >> 4 |
-                              (c & 0x0F0) << 8 |
-                              (c & 0x00F) << 20;
-        }
-
-        MODE &= 0x0FFF;
-
-not_hblank:
-
-        uint8_t txtbuf_char = 0, local_x = x & 7, local_y = y & 7;
-
-        if (MODE & F_TXTBUF)
-            txtbuf_char = vram[TXTBUF + (x >> 3) + (W >> 3) * (y >> 3)];
-
-        if (txtbuf_char) {
-            buffer[i] = cram_cache[MODE & F_BG_COL];
-            if (txtbuf_char & 128) buffer[i] = ~buffer[i];
-            txtbuf_char &= 127;
-            if (cgram[(txtbuf_char << 3) + local_y] >> (7 - local_x) & 1)
-                buffer[i] = ~buffer[i];
-
-            continue;
-        }
-
-        uint16_t plane_a_pixels = 0, plane_b_pixels = 0, sprites_pixels = 0;
-
-        idx = 0;
-        while (idx < 32*4 && (MODE & F_SPRITES)) {
-            uint16_t base1 = sprite_cache[idx++], base2 = sprite_cache[idx++],
-                     x_pos = sprite_cache[idx++], y_pos = sprite_cache[idx++];
-
-            if (!(base1 & 2047)) break;
-
-            uint16_t local_x = (x - x_pos) & 511, local_y = (y - y_pos) & 255;
-
-            uint8_t hsize = ((base2 >> 8  & 3) + 1) << 3,
-                    vsize = ((base2 >> 10 & 3) + 1) << 3;
-
-            if ((local_x >= hsize || local_y >= vsize) ||
-                (sprites_pixels & 15 && !(base1 & 32768))) continue;
-
-            if (base1 >> 11 & 1) local_x = hsize - 1 - local_x;
-            if (base1 >> 12 & 1) local_y = vsize - 1 - local_y;
-
-            uint16_t addr = (((base1 & 2047) + (local_x >> 3) *
-                    (vsize >> 3) + (local_y >> 3)) << 5) +
-                    ((local_y & 7) << 2) + ((local_x & 7) >> 1);
-
-            uint8_t pixel = vram[addr] >> ((~local_x & 1) << 2) & 15;
-
-            if (!pixel) continue;
-
-            pixel |= base1 >> 9 & F_BG_COL;
-
-            if (base1 & 32768) { sprites_pixels |= pixel << 8; break; }
-            if (!(sprites_pixels & 0xFF)) sprites_pixels |= pixel;
-        }
-        if (sprites_pixels & 0x0F00) { color = sprites_pixels >> 8; goto put; }
-
-        if (MODE & F_PLANE_A)
-            PLANE_GET_PX(PLANE_A, PLANE_A_X, PLANE_A_Y, plane_a_pixels);
-        if (plane_a_pixels & 0x0F00) { color = plane_a_pixels >> 8; goto put; }
-
-        if (MODE & F_PLANE_B)
-            PLANE_GET_PX(PLANE_B, PLANE_B_X, PLANE_B_Y, plane_b_pixels);
-        if (plane_b_pixels & 0x0F00) { color = plane_b_pixels >> 8; goto put; }
-
-        if (sprites_pixels & 0xF) { color = sprites_pixels; goto put; }
-        if (plane_a_pixels & 0xF) { color = plane_a_pixels; goto put; }
-        if (plane_b_pixels & 0xF) { color = plane_b_pixels; goto put; }
-
-        color = MODE & F_BG_COL;
-
-put:    buffer[i] = cram_cache[color & 63];
-    }
-}
-
-#undef W
-#undef H
-#undef F_TXTBUF
-#undef F_SPRITES
-#undef F_PLANE_A
-#undef F_PLANE_B
-#undef F_BG_COL
-#undef F_HBLANK
-#undef F_VBLANK
-#undef F_REGS_W
-#undef F_VRAM_W
-#undef F_CRAM_W
-#undef COMMAND
-#undef MODE
-#undef USER_A
-#undef USER_B
-#undef USER_C
-#undef HBLANK
-#undef HBLANK_Y
-#undef VBLANK
-#undef TXTBUF
-#undef SPRITES
-#undef PLANE_A
-#undef PLANE_A_X
-#undef PLANE_A_Y
-#undef PLANE_B
-#undef PLANE_B_X
-#undef PLANE_B_Y
-#undef PLANE_GET_PX
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "dev.h"
+#include "prof.h"
+#include "trace.h"
+#include "uxn.h"
+
+/* ==========================================================================
+   B6X VIDEO DISPLAY PROCESSOR
+   ========================================================================== */
+
+#define W 320 /* - Screen width  */
+#define H 224 /* - Screen height */
+
+/* === MODE Register fields === */
+#define F_TXTBUF  0b0000000000000001 /* - Show text buffer                */
+#define F_SPRITES 0b0000000000000010 /* - Show sprites                    */
+#define F_PLANE_A 0b0000000000000100 /* - Show tile layer A               */
+#define F_PLANE_B 0b0000000000001000 /* - Show tile layer B               */
+#define F_BG_COL  0b0000000000110000 /* - Palette row of background color */
+#define F_HBLANK  0b0000000001000000 /* - Enable H-blank vector           */
+#define F_VBLANK  0b0000000010000000 /* - Enable V-blank vector           */
+#define F_HSCR_A  0b0000000100000000 /* - Enable layer A line scroll      */
+#define F_VSCR_A  0b0000001000000000 /* - Enable layer A column scroll    */
+#define F_HSCR_B  0b0000010000000000 /* - Enable layer B line scroll      */
+#define F_VSCR_B  0b0000100000000000 /* - Enable layer B column scroll    */
+
+#define F_REGS_W  0b0001000000000000 /* - Register write indicator        */
+#define F_VRAM_W  0b0010000000000000 /* - VRAM write indicator            */
+#define F_CRAM_W  0b0100000000000000 /* - CRAM write indicator            */
+#define F_CGRAM_W 0b1000000000000000 /* - CGRAM write indicator           */
+
+#define K_COLLIDE 0b0000000000010000 /* - Kernel detects sprite collisions */
+
+/* === Register aliases === */
+#define COMMAND   regs[0x0]  /* - Command of DEO/DEI operation            */
+#define MODE      regs[0x1]  /* - VDP mode and indicators                 */
+
+#define USER_A    regs[0x2]  /* - User register A                         */
+#define USER_B    regs[0x3]  /* - User register B                         */
+#define USER_C    regs[0x4]  /* - User register C                         */
+
+#define HBLANK    regs[0x5]  /* - H-blank vector location in RAM          */
+#define HBLANK_Y  regs[0x6]  /* - H-blank vector trigger line             */
+#define VBLANK    regs[0x7]  /* - V-blank vector location in RAM          */
+
+#define TXTBUF    regs[0x8]  /* - Text buffer location in VRAM            */
+#define SPRITES   regs[0x9]  /* - Sprite attribute table location in VRAM */
+
+#define PLANE_A   regs[0xA]  /* - Tile layer A location in VRAM           */
+#define PLANE_A_X regs[0xB]  /* - Layer A horizontal scroll               */
+#define PLANE_A_Y regs[0xC]  /* - Layer A vertical scroll                 */
+
+#define PLANE_B   regs[0xD]  /* - Tile layer B location in VRAM           */
+#define PLANE_B_X regs[0xE]  /* - Layer B horizontal scroll               */
+#define PLANE_B_Y regs[0xF]  /* - Layer B vertical scroll                 */
+
+#define HSCR_A    regs[0x10] /* - Layer A line scroll table in VRAM       */
+#define VSCR_A    regs[0x11] /* - Layer A column scroll table in VRAM     */
+#define HSCR_B    regs[0x12] /* - Layer B line scroll table in VRAM       */
+#define VSCR_B    regs[0x13] /* - Layer B column scroll table in VRAM     */
+
+#define COLLIDE   regs[0x14] /* - Sprite collision detection (bit 0)      */
+
+#define FADE      regs[0x15] /* - Fade color 0BGR, fade level in bits 12+ */
+#define TINT      regs[0x16] /* - Per-channel attenuation 0BGR            */
+#define BRIGHT    regs[0x17] /* - Brightness added to channels (signed)   */
+#define FX_MASK   regs[0x18] /* - Palette rows excluded from effects      */
+
+static void circ_fill(struct b6x *m, void *d, size_t i, size_t s,
+                                                uint8_t c, size_t n) {
+    PROF_ADD(m, vdp_bytes, n >= s ? s : n);
+    if (n >= s) { memset(d, c, s); return; }
+
+    i %= s;
+
+    while (n) {
+        size_t a = (a = s - i) > n ? n : a;
+        memset(d+i, c, a);
+        i = (i + a) % s;
+        n -= a;
+    }
+}
+
+static void circ_copy(struct b6x *m, void *d, size_t di, size_t ds,
+                                     void *s, size_t si, size_t ss, size_t n) {
+    PROF_ADD(m, vdp_bytes, n);
+    di %= ds; si %= ss;
+
+    while (n) {
+        size_t a = ds - di;
+        if (a > ss - si) a = ss - si;
+        if (a > n) a = n;
+        memcpy(d+di, s+si, a);
+        di = (di + a) % ds;
+        si = (si + a) % ss;
+        n -= a;
+    }
+}
+
+void dev_vdp_deo(struct uxn *u, uint8_t *port) {
+    struct b6x *m = B6X(u);
+    uint16_t *regs = m->vdp.regs, *cram = m->vdp.cram;
+    uint8_t  *vram = m->vdp.vram;
+    port--;
+
+    if (m->vdp.port_left && !m->vdp.port_read) {
+        POKE2(m->vdp.port_addr, vram, 0xFFFF, PEEK2(0, port, 1));
+        PROF_ADD(m, vdp_bytes, 2);
+
+        m->vdp.port_addr += m->vdp.port_inc;
+        m->vdp.port_left--;
+        MODE |= F_VRAM_W;
+        return;
+    }
+
+    if (!COMMAND) { COMMAND = PEEK2(0, port, 1); return; }
+
+    uint8_t parameter = COMMAND >> 8;
+
+    /* printf("VDP %04x %04x\n", PEEK2(0, port, 1), COMMAND); */
+
+    PROF_ADD(m, vdp_cmds[COMMAND & 31], 1);
+
+    switch (COMMAND & 31) {
+        /* === Register access === */
+        case 0x00: regs[parameter & 31] = 0; break;
+        case 0x01:
+        case 0x02: regs[parameter & 31] = port[COMMAND & 1]; break;
+        case 0x03: regs[parameter & 31] = PEEK2(0, port, 1); break;
+
+        /* === Palette access === */
+        case 0x04: cram[parameter & 63] = 0; break;
+        case 0x05:
+        case 0x06: cram[parameter & 63] = port[COMMAND & 1]; break;
+        case 0x07: cram[parameter & 63] = PEEK2(0, port, 1); break;
+
+        /* === VRAM access 1 === */
+        case 0x08: vram[PEEK2(0, port, 1)] = 0; break;
+        case 0x09:
+        case 0x0A: vram[regs[parameter & 15]] = port[COMMAND & 1]; break;
+        case 0x0B: circ_copy(m, vram, regs[parameter & 15], 65536,
+                             u->ram, regs[parameter >> 4], 65536,
+                                               PEEK2(0, port, 1)); break;
+
+        /* === VRAM access 2 === */
+        case 0x0C: circ_fill(m, vram, regs[parameter & 15], 65536,
+                                   0, PEEK2(0, port, 1)); break;
+        case 0x0D:
+        case 0x0E: circ_fill(m, vram, regs[parameter & 15], 65536,
+                   port[COMMAND & 1], regs[parameter >> 4]); break;
+        case 0x0F: circ_copy(m, vram, regs[parameter & 15], 65536,
+                          port, 0, 2, regs[parameter >> 4]); break;
+
+        /* === CGRAM Font setting === */
+        case 0x10: circ_copy(m, m->vdp.cgram, 0, 1024,
+                   u->ram, PEEK2(0, port, 1), 65536, 1024); break;
+
+        /* === VRAM access 3 === */
+        case 0x14: dev_rom_read(m, vram, regs[parameter & 15], 65536,
+                         regs[parameter >> 4], PEEK2(0, port, 1)); break;
+
+        /* === VRAM data port === */
+        case 0x15:
+        case 0x16: m->vdp.port_addr = regs[parameter & 15];
+                   m->vdp.port_inc  = regs[parameter >> 4];
+                   m->vdp.port_left = PEEK2(0, port, 1);
+                   m->vdp.port_read = COMMAND & 2; break;
+
+        default: break;
+    }
+
+    /* A read stream leaves VRAM as it is */
+    if ((COMMAND & 31) != 0x16)
+        MODE |= (uint16_t[]) { F_REGS_W, F_CRAM_W, F_VRAM_W, F_VRAM_W,
+                               F_CGRAM_W, F_VRAM_W, 0, 0 }[COMMAND >> 2 & 7];
+
+    /* Color effect registers take effect through the palette cache */
+    if ((COMMAND & 31) < 4 && (parameter & 31) >= 0x15
+                           && (parameter & 31) <= 0x18) MODE |= F_CRAM_W;
+    COMMAND = 0;
+}
+
+
+uint8_t dev_vdp_dei(struct uxn *u, uint8_t *port) {
+    struct b6x *m = B6X(u);
+    uint16_t *regs = m->vdp.regs, *cram = m->vdp.cram;
+    uint8_t  *vram = m->vdp.vram;
+
+    uint8_t  parameter = COMMAND >> 8;
+    uint16_t data = 0;
+
+    if (m->vdp.port_left && m->vdp.port_read) {
+        POKE2(0, port, 1, PEEK2(m->vdp.port_addr, vram, 0xFFFF));
+
+        m->vdp.port_addr += m->vdp.port_inc;
+        m->vdp.port_left--;
+        return *port;
+    }
+
+    switch (COMMAND & 15) {
+        case 0x00: data = regs[parameter & 31]; break;
+        case 0x01: data = cram[parameter & 63]; break;
+        case 0x02: data = PEEK2(regs[parameter & 15], vram, 0xFFFF); break;
+        case 0x03: data = m->vdp.collide[parameter & 7]; break;
+        case 0x04: for (uint8_t i = 0; i < 8; i++)
+                       data += __builtin_popcount(m->vdp.collide[i]);
+                   break;
+    }
+
+    POKE2(0, port, 1, data);
+    COMMAND = 0;
+
+    return *port;
+}
+
+#define PLANE_GET_PX(plane, plane_x, plane_y, plane_pixels)        \
+    do {                                                           \
+        uint16_t scrolled_x = x + (plane_x),                       \
+                 scrolled_y = y + (plane_y);                       \
+                                                                   \
+        uint8_t column = scrolled_x >> 3 & 63,                     \
+                row    = scrolled_y >> 3 & 31;                     \
+                                                                   \
+        uint16_t addr  = (plane) + (column << 1) + (row << 7),     \
+                 entry = PEEK2(addr, vram, 0xFFFF);                \
+                                                                   \
+        uint16_t pattern_id = entry & 2047;                        \
+                                                                   \
+        if (!pattern_id) break;                                    \
+                                                                   \
+        local_x = scrolled_x & 7, local_y = scrolled_y & 7;        \
+                                                                   \
+        if (entry & 2048) local_x = 7 - local_x;                   \
+        if (entry & 4096) local_y = 7 - local_y;                   \
+                                                                   \
+        addr = (pattern_id << 5) + (local_y << 2) + (local_x >> 1);\
+                                                                   \
+        uint8_t pixel = vram[addr] >> ((~local_x & 1) << 2) & 15;  \
+                                                                   \
+        if (!pixel) break;                                         \
+                                                                   \
+        pixel |= entry >> 9 & F_BG_COL;                            \
+                                                                   \
+        if (entry & 32768) plane_pixels |= pixel << 8;             \
+        else               plane_pixels  = pixel;                  \
+                                                                   \
+    } while (0);
+
+static inline uint32_t cram_argb(uint16_t c) {
+    return (c & 0xF00) >> 4 | (c & 0x0F0) << 8 | (c & 0x00F) << 20;
+}
+
+/* Tint, then brightness, then fade, for every channel of a 0BGR color */
+static uint16_t color_fx(uint16_t *regs, uint16_t c) {
+    uint16_t out = 0;
+
+    for (uint8_t shift = 0; shift < 12; shift += 4) {
+        int32_t v = c >> shift & 15;
+
+        v -= v * (TINT >> shift & 15) / 15;
+        v += (int8_t)BRIGHT;
+        v  = v < 0 ? 0 : v > 15 ? 15 : v;
+        v += ((FADE >> shift & 15) - v) * (FADE >> 12) / 15;
+
+        out |= v << shift;
+    }
+
+    return out;
+}
+
+/* Index bit 7 inverts the color, as used by the text buffer */
+#define CONVERT(k) out[x + k] = colors[index[x + k] & 63] ^   \
+                                -(uint32_t)(index[x + k] >> 7)
+
+static void convert_line(const uint8_t *index, const uint32_t *colors,
+                                                     uint32_t *out) {
+    for (uint32_t x = 0; x < W; x += 8) {
+        CONVERT(0); CONVERT(1); CONVERT(2); CONVERT(3);
+        CONVERT(4); CONVERT(5); CONVERT(6); CONVERT(7);
+    }
+}
+
+#undef CONVERT
+
+void dev_vdp_convert(const uint8_t *index, const uint16_t *palette,
+                                                  uint32_t *buffer) {
+    uint32_t colors[64];
+
+    for (uint32_t y = 0; y < H; y++, index += W, buffer += W) {
+        const uint16_t *row = palette + y * 64;
+
+        if (!y || memcmp(row, row - 64, 64 * sizeof(*row)))
+            for (uint8_t idx = 0; idx < 64; idx++)
+                colors[idx] = cram_argb(row[idx]);
+
+        convert_line(index, colors, buffer);
+    }
+}
+
+/* === Line state handed to the render kernels === */
+struct line {
+    uint16_t  y, mode;
+    uint16_t  plane_a_x, plane_b_x;   /* - Scroll with line scroll applied */
+    uint16_t *sprite_cache;
+};
+
+/* Template of the render kernels, layers is a constant MODE & 15 and
+   K_COLLIDE. Collision checks keep looking at sprites after the pixel is
+   decided, also under the text buffer. */
+static inline __attribute__((always_inline))
+void render_line(struct b6x *m, const struct line *l, uint8_t *out,
+                                                 const uint16_t layers) {
+    uint16_t *regs = m->vdp.regs, *collide = m->vdp.collide;
+    uint8_t  *vram = m->vdp.vram, *cgram = m->vdp.cgram;
+
+    const uint16_t y = l->y, mode = l->mode, *sprite_cache = l->sprite_cache;
+    const uint16_t plane_a = PLANE_A, plane_a_x = l->plane_a_x,
+                   plane_b = PLANE_B, plane_b_x = l->plane_b_x,
+                   txtbuf  = TXTBUF + (W >> 3) * (y >> 3);
+
+    uint16_t plane_a_y = PLANE_A_Y, plane_b_y = PLANE_B_Y;
+    uint8_t color;
+
+    for (uint16_t x = 0; x < W; x++) {
+        if ((layers & F_PLANE_A) && (mode & F_VSCR_A) && !(x & 15))
+            plane_a_y = PLANE_A_Y +
+                        PEEK2(VSCR_A + (x >> 4 << 1), vram, 0xFFFF);
+        if ((layers & F_PLANE_B) && (mode & F_VSCR_B) && !(x & 15))
+            plane_b_y = PLANE_B_Y +
+                        PEEK2(VSCR_B + (x >> 4 << 1), vram, 0xFFFF);
+
+        uint8_t local_x = x & 7, local_y = y & 7, covered = 0, first = 128;
+
+        if (layers & F_TXTBUF) {
+            uint8_t txtbuf_char = vram[(uint16_t)(txtbuf + (x >> 3))];
+
+            if (txtbuf_char) {
+                uint8_t glyph = cgram[((txtbuf_char & 127) << 3) + local_y];
+
+                out[x] = (mode & F_BG_COL) |
+                         ((txtbuf_char ^ glyph << local_x) & 128);
+                if (!(layers & K_COLLIDE)) continue;
+                covered = 1;
+            }
+        }
+
+        uint16_t plane_a_pixels = 0, plane_b_pixels = 0, sprites_pixels = 0;
+
+        for (uint16_t idx = 0; (layers & F_SPRITES) && idx < 32*4;) {
+            uint16_t base1 = sprite_cache[idx++], base2 = sprite_cache[idx++],
+                     x_pos = sprite_cache[idx++], y_pos = sprite_cache[idx++];
+
+            if (!(base1 & 2047)) break;
+
+            uint16_t local_x = (x - x_pos) & 511, local_y = (y - y_pos) & 255;
+
+            uint8_t hsize = ((base2 >> 8  & 3) + 1) << 3,
+                    vsize = ((base2 >> 10 & 3) + 1) << 3;
+
+            if ((local_x >= hsize || local_y >= vsize) ||
+                (!(layers & K_COLLIDE) &&
+                 sprites_pixels & 15 && !(base1 & 32768))) continue;
+
+            if (base1 >> 11 & 1) local_x = hsize - 1 - local_x;
+            if (base1 >> 12 & 1) local_y = vsize - 1 - local_y;
+
+            uint16_t addr = (((base1 & 2047) + (local_x >> 3) *
+                    (vsize >> 3) + (local_y >> 3)) << 5) +
+                    ((local_y & 7) << 2) + ((local_x & 7) >> 1);
+
+            uint8_t pixel = vram[addr] >> ((~local_x & 1) << 2) & 15;
+
+            if (!pixel) continue;
+
+            /* Cached BASE2 holds the SAT entry in place of the link */
+            if (layers & K_COLLIDE) {
+                uint8_t entry = base2 & 127;
+
+                if (first == 128) first = entry; else {
+                    collide[first >> 4] |= 1 << (first & 15);
+                    collide[entry >> 4] |= 1 << (entry & 15);
+                }
+                if (sprites_pixels & 0x0F00) continue;
+            }
+
+            pixel |= base1 >> 9 & F_BG_COL;
+
+            if (base1 & 32768) {
+                sprites_pixels |= pixel << 8;
+                if (!(layers & K_COLLIDE)) break; else continue;
+            }
+            if (!(sprites_pixels & 0xFF)) sprites_pixels |= pixel;
+        }
+        if ((layers & K_COLLIDE) && covered) continue;
+        if (sprites_pixels & 0x0F00) { color = sprites_pixels >> 8; goto put; }
+
+        if (layers & F_PLANE_A)
+            PLANE_GET_PX(plane_a, plane_a_x, plane_a_y, plane_a_pixels);
+        if (plane_a_pixels & 0x0F00) { color = plane_a_pixels >> 8; goto put; }
+
+        if (layers & F_PLANE_B)
+            PLANE_GET_PX(plane_b, plane_b_x, plane_b_y, plane_b_pixels);
+        if (plane_b_pixels & 0x0F00) { color = plane_b_pixels >> 8; goto put; }
+
+        if (sprites_pixels & 0xF) { color = sprites_pixels; goto put; }
+        if (plane_a_pixels & 0xF) { color = plane_a_pixels; goto put; }
+        if (plane_b_pixels & 0xF) { color = plane_b_pixels; goto put; }
+
+        color = mode & F_BG_COL;
+
+put:    out[x] = color & 63;
+    }
+}
+
+#define KERNEL(n)                                                          \
+    static void render_line_##n(struct b6x *m, const struct line *l,       \
+                                uint8_t *out) { render_line(m, l, out, n); }
+
+KERNEL(0)  KERNEL(1)  KERNEL(2)  KERNEL(3)
+KERNEL(4)  KERNEL(5)  KERNEL(6)  KERNEL(7)
+KERNEL(8)  KERNEL(9)  KERNEL(10) KERNEL(11)
+KERNEL(12) KERNEL(13) KERNEL(14) KERNEL(15)
+KERNEL(16) KERNEL(17) KERNEL(18) KERNEL(19)
+KERNEL(20) KERNEL(21) KERNEL(22) KERNEL(23)
+KERNEL(24) KERNEL(25) KERNEL(26) KERNEL(27)
+KERNEL(28) KERNEL(29) KERNEL(30) KERNEL(31)
+
+#undef KERNEL
+
+/* === Render kernels by enabled layers (MODE & 15) and K_COLLIDE === */
+static void (*const kernels[32])(struct b6x *, const struct line *,
+                                                           uint8_t *) = {
+    render_line_0,  render_line_1,  render_line_2,  render_line_3,
+    render_line_4,  render_line_5,  render_line_6,  render_line_7,
+    render_line_8,  render_line_9,  render_line_10, render_line_11,
+    render_line_12, render_line_13, render_line_14, render_line_15,
+    render_line_16, render_line_17, render_line_18, render_line_19,
+    render_line_20, render_line_21, render_line_22, render_line_23,
+    render_line_24, render_line_25, render_line_26, render_line_27,
+    render_line_28, render_line_29, render_line_30, render_line_31
+};
+
+static void vdp_frame(struct b6x *m, uint32_t *buffer,
+                      uint8_t *index, uint16_t *palette) {
+    uint16_t *regs = m->vdp.regs, *cram = m->vdp.cram;
+    uint8_t  *vram = m->vdp.vram;
+
+    uint8_t line_index[W];
+
+    uint16_t sprite_cache[128] = { 0 };
+    uint32_t cram_cache[64]    = { 0 };
+    uint16_t colors[64]        = { 0 };
+
+    m->vdp.frame++;
+    m->vdp.line = H;
+
+    if (m->uxn.trace)
+        trace_frame(m->uxn.trace, m->vdp.frame, m->vdp.speculative);
+
+    dev_ctl_flush(m);
+
+    if (MODE & F_VBLANK)
+        PROF_TIME(m, PROF_VBLANK, uxn_eval(&m->uxn, VBLANK));
+
+    /* A shown frame is drawn after hidden ones even if nothing was
+       written, the host has no picture of them */
+    if (!(MODE & 0xF000) && !(m->vdp.redraw && (buffer || index))) return;
+
+    /* Hidden frames run the same vectors and clear the same indicators as
+       drawn ones, only the pixels are skipped. Frames with collision
+       detection are still rasterized, to a scratch line */
+    uint8_t draw = buffer || index || (COLLIDE & 1);
+    m->vdp.redraw = !buffer && !index;
+
+    uint64_t raster_t0 = PROF_NOW(m);
+
+    MODE |= F_CRAM_W;
+    memset(m->vdp.collide, 0, sizeof(m->vdp.collide));
+
+    for (uint16_t y = 0; y < H; y++) {
+        m->vdp.line = y;
+
+        if (m->uxn.trace) trace_put(m->uxn.trace, TRACE_LINE, 0, y, 0);
+
+        uint16_t link = SPRITES, idx = 0;
+        sprite_cache[0] = 0;
+
+        while (draw && (MODE & F_SPRITES) && idx != 80*4) {
+            uint16_t base1 = PEEK2(link,     vram, 0xFFFF),
+                     base2 = PEEK2(link + 2, vram, 0xFFFF),
+                     x_pos = PEEK2(link + 4, vram, 0xFFFF) & 511,
+                     y_pos = PEEK2(link + 6, vram, 0xFFFF) & 255;
+
+            if (!(base1 & 2047)) goto skip;
+
+            uint8_t hsize = ((base2 >> 8  & 3) + 1) << 3,
+                    vsize = ((base2 >> 10 & 3) + 1) << 3;
+
+            if (x_pos >= 320 && x_pos < (512 - hsize)) goto skip;
+
+            uint8_t v_dist = y - y_pos;
+            if (v_dist >= vsize) goto skip;
+
+            sprite_cache[idx++ & 127] = base1;
+            sprite_cache[idx++ & 127] = (base2 & ~127) |
+                                        ((uint16_t)(link - SPRITES) >> 3 & 127);
+            sprite_cache[idx++ & 127] = x_pos;
+            sprite_cache[idx++ & 127] = y_pos;
+
+            if ((idx >> 2) < 32) sprite_cache[idx & 127] = 0;
+
+            skip:
+            if (link == ((base2 & 127) << 3) + SPRITES) break;
+            link = (base2 & 127) << 3;
+            link += SPRITES;
+        }
+
+        if ((MODE & F_HBLANK) && y == HBLANK_Y)
+            PROF_TIME(m, PROF_HBLANK, uxn_eval(&m->uxn, HBLANK));
+
+        if (draw && (MODE & F_CRAM_W)) {
+            uint8_t fx = FADE >> 12 || TINT & 0xFFF || BRIGHT & 0xFF;
+
+            for (uint8_t idx = 0; idx < 64; idx++) {
+                colors[idx] = fx && !(FX_MASK >> (idx >> 4) & 1) ?
+                              color_fx(regs, cram[idx]) : cram[idx];
+                cram_cache[idx] = cram_argb(colors[idx]);
+            }
+        }
+
+        if (palette) memcpy(palette + y * 64, colors, sizeof(colors));
+
+        MODE &= 0x0FFF;
+        if (!draw) continue;
+
+        struct line l = { y, MODE, PLANE_A_X, PLANE_B_X, sprite_cache };
+
+        if (MODE & F_HSCR_A)
+            l.plane_a_x += PEEK2(HSCR_A + (y << 1), vram, 0xFFFF);
+        if (MODE & F_HSCR_B)
+            l.plane_b_x += PEEK2(HSCR_B + (y << 1), vram, 0xFFFF);
+
+        uint8_t *line = index ? index + y * W : line_index;
+
+        kernels[(MODE & 15) | (COLLIDE & 1) << 4](m, &l, line);
+
+        if (buffer) convert_line(line, cram_cache, buffer + y * W);
+    }
+
+    m->vdp.line = H;
+
+    PROF_SINCE(m, PROF_RASTER, raster_t0);
+}
+
+void dev_vdp(struct b6x *m, uint32_t *buffer) {
+    vdp_frame(m, buffer, NULL, NULL);
+}
+
+void dev_vdp_indexed(struct b6x *m, uint8_t *index, uint16_t *palette) {
+    vdp_frame(m, NULL, index, palette);
+}
+
+#undef W
+#undef H
+#undef F_TXTBUF
+#undef F_SPRITES
+#undef F_PLANE_A
+#undef F_PLANE_B
+#undef F_BG_COL
+#undef F_HBLANK
+#undef F_VBLANK
+#undef F_HSCR_A
+#undef F_VSCR_A
+#undef F_HSCR_B
+#undef F_VSCR_B
+#undef F_REGS_W
+#undef F_VRAM_W
+#undef F_CRAM_W
+#undef COMMAND
+#undef MODE
+#undef USER_A
+#undef USER_B
+#undef USER_C
+#undef HBLANK
+#undef HBLANK_Y
+#undef VBLANK
+#undef TXTBUF
+#undef SPRITES
+#undef PLANE_A
+#undef PLANE_A_X
+#undef PLANE_A_Y
+#undef PLANE_B
+#undef PLANE_B_X
+#undef PLANE_B_Y
+#undef HSCR_A
+#undef VSCR_A
+#undef HSCR_B
+#undef VSCR_B
+#undef COLLIDE
+#undef FADE
+#undef TINT
+#undef BRIGHT
+#undef FX_MASK
+#undef K_COLLIDE
+#undef PLANE_GET_PX
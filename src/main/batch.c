@@ -0,0 +1,353 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "uxn.h"
+#include "dev.h"
+#include "bios.h"
+
+/* ==========================================================================
+   B6X HEADLESS BATCH RUNNER
+   ========================================================================== */
+
+#define WIDTH 320
+#define HEIGHT 224
+
+struct image {
+    const char *fname;
+    uint8_t    *data;
+    size_t      size;
+};
+
+struct job {
+    struct image *image;
+    uint32_t      instance;
+    uint32_t      hash;          /* - FNV-1a of the last indexed frame    */
+    uint64_t      instrs;        /* - Instructions executed               */
+};
+
+static struct job *jobs;
+static size_t      jobs_count, jobs_next;
+static uint32_t    frames = 600;
+static uint8_t     runahead = 0;
+static int         random_input = 0;
+static const char *frames_dir = NULL;
+static const char *golden = NULL;
+
+static pthread_mutex_t jobs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void dev_meta_deo(struct uxn *u, uint8_t *port) {}
+
+static uint32_t xorshift(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    return *state = x;
+}
+
+static uint32_t fnv1a(uint32_t hash, const uint8_t *data, size_t size) {
+    while (size--) {
+        hash ^= *data++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static const char *base_name(const char *fname) {
+    for (const char *f = fname; *f; f++)
+        if (*f == '/' || *f == '\\') fname = f + 1;
+    return fname;
+}
+
+/* Last frame as a binary PPM, <dir>/<rom file name>-<instance>.ppm */
+static void write_frame(const struct job *job, const uint8_t *index,
+                        const uint16_t *palette) {
+    const char *fname = base_name(job->image->fname);
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s-%u.ppm", frames_dir, fname,
+             job->instance);
+
+    uint32_t *buffer = malloc(WIDTH * HEIGHT * sizeof(uint32_t));
+    FILE *out = buffer ? fopen(path, "wb") : NULL;
+
+    if (out) {
+        dev_vdp_convert(index, palette, buffer);
+
+        fprintf(out, "P6\n%d %d\n255\n", WIDTH, HEIGHT);
+        for (size_t i = 0; i < WIDTH * HEIGHT; i++) {
+            uint8_t rgb[3] = { buffer[i] >> 16, buffer[i] >> 8, buffer[i] };
+            fwrite(rgb, sizeof(rgb), 1, out);
+        }
+    }
+    if (!out || ferror(out) | fclose(out))
+        fprintf(stderr, "ERROR: Can't write frame: %s\n", path);
+    free(buffer);
+}
+
+static void run_job(struct job *job, struct b6x *m, struct b6x *snapshot,
+                    uint8_t *index, uint16_t *palette) {
+    uint32_t seed = job->instance * 2654435761u + 1, held = 0;
+
+    memset(m, 0, sizeof(*m));
+    memset(index, 0, WIDTH * HEIGHT);
+    memset(palette, 0, HEIGHT * 64 * sizeof(*palette));
+
+    dev_init(m);
+    dev_rom_attach(m, job->image->data, job->image->size);
+
+    memcpy(m->uxn.ram, bios, bios_len);
+    uxn_eval(&m->uxn, 0);
+
+    for (uint32_t f = 0; f < frames; f++) {
+        if (random_input && !(xorshift(&seed) & 7)) {
+            uint8_t button = xorshift(&seed) & 15;
+            held ^= 1 << button;
+            dev_ctl(m, (held >> button & 1) << 7 | button);
+        }
+
+        /* The last frame is the real one and always drawn, so the hash
+           shows the final state and -a gives the same results */
+        if (f + 1 == frames) m->vdp.redraw = 1;
+        dev_runahead_indexed(m, snapshot, index, palette,
+                             f + 1 < frames ? runahead : 0);
+    }
+
+    /* Hash of the CRAM indices and the palettes of all lines, frames are
+       never converted to ARGB */
+    uint32_t hash = fnv1a(2166136261u, index, WIDTH * HEIGHT);
+    for (size_t i = 0; i < HEIGHT * 64; i++) {
+        uint8_t color[2] = { palette[i] >> 8, palette[i] };
+        hash = fnv1a(hash, color, sizeof(color));
+    }
+
+    job->hash   = hash;
+    job->instrs = m->uxn.icount;
+
+    if (frames_dir) write_frame(job, index, palette);
+}
+
+static void *worker(void *arg) {
+    struct b6x *m        = malloc(sizeof(struct b6x));
+    struct b6x *snapshot = malloc(sizeof(struct b6x));
+    uint8_t    *index    = malloc(WIDTH * HEIGHT);
+    uint16_t   *palette  = malloc(HEIGHT * 64 * sizeof(uint16_t));
+
+    if (!m || !snapshot || !index || !palette) {
+        perror("ERROR: Can't allocate machine");
+        free(m); free(snapshot); free(index); free(palette);
+        return NULL;
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&jobs_lock);
+        size_t idx = jobs_next < jobs_count ? jobs_next++ : jobs_count;
+        pthread_mutex_unlock(&jobs_lock);
+
+        if (idx == jobs_count) break;
+        run_job(&jobs[idx], m, snapshot, index, palette);
+    }
+
+    free(m);
+    free(snapshot);
+    free(index);
+    free(palette);
+    return NULL;
+}
+
+/* Parses a decimal flag value, non-zero if it is not a number up to max */
+static int parse_number(const char *text, unsigned long max,
+                                          unsigned long *value) {
+    char *end;
+
+    errno  = 0;
+    *value = strtoul(text, &end, 10);
+    return *text < '0' || *text > '9' || *end || errno || *value > max;
+}
+
+/* Compares the results with golden ones in the output format, matched by
+   ROM file name without directories and instance. Returns the number of
+   instances that differ or have no golden result. */
+static size_t check_golden(void) {
+    FILE *in = fopen(golden, "r");
+    uint8_t *seen = calloc(jobs_count, 1);
+    size_t failed = 0;
+
+    if (!in || !seen) {
+        perror("ERROR: Can't read golden results");
+        if (in) fclose(in);
+        free(seen);
+        return jobs_count;
+    }
+
+    char rom[4096];
+    unsigned instance, count, hash;
+    unsigned long long instrs;
+
+    while (fscanf(in, "%4095s %u %u %x %llu",
+                  rom, &instance, &count, &hash, &instrs) == 5) {
+        for (size_t i = 0; i < jobs_count; i++) {
+            struct job *job = &jobs[i];
+
+            if (seen[i] || job->instance != instance ||
+                strcmp(base_name(job->image->fname), base_name(rom))) continue;
+            seen[i] = 1;
+
+            if (count == frames && job->hash == hash && job->instrs == instrs)
+                continue;
+
+            fprintf(stderr, "FAIL %s %u: %u %08x %llu, expected %u %08x %llu\n",
+                    job->image->fname, instance, frames, job->hash,
+                    (unsigned long long)job->instrs, count, hash, instrs);
+            failed++;
+        }
+    }
+
+    for (size_t i = 0; i < jobs_count; i++) {
+        if (seen[i]) continue;
+        fprintf(stderr, "FAIL %s %u: no golden result\n",
+                jobs[i].image->fname, jobs[i].instance);
+        failed++;
+    }
+
+    fclose(in);
+    free(seen);
+    return failed;
+}
+
+static void show_usage(char **argv) {
+    fprintf(stderr, "Usage: %s [flags] <rom> [rom...]\n", argv[0]);
+    fprintf(stderr, "Run B6X ROMs headless on a pool of threads.\n");
+    fprintf(stderr, "Print a hash of the last frame of every instance.\n\n");
+
+    fprintf(stderr,
+        "Flags:\n"
+        "  -h            Show this help message\n"
+        "  -j  <threads> Worker threads (default: online CPUs)\n"
+        "  -n  <count>   Instances of every ROM (default: 1)\n"
+        "  -f  <frames>  Frames to run every instance (default: 600)\n"
+        "  -r            Random controller input, seeded per instance\n"
+        "  -a  <frames>  Run ahead every frame, up to 255 (default: 0)\n"
+        "  -o  <dir>     Write the last frame of every instance as PPM\n"
+        "  -g  <file>    Compare with golden results, fail if any differs\n\n"
+    );
+}
+
+int main(int argc, char **argv) {
+    struct image *images = calloc(argc, sizeof(struct image));
+    size_t images_count = 0;
+    uint32_t instances = 1;
+    unsigned long number;
+    long threads = 0;
+
+    if (!images) { perror("ERROR: Can't allocate"); return 1; }
+
+    for (int argi = 1; argi < argc; argi++) {
+        if (!strcmp(argv[argi], "-h")) { show_usage(argv); return 0; }
+        if (!strcmp(argv[argi], "-r")) { random_input = 1; continue; }
+
+        if (argi + 1 < argc) {
+            if (!strcmp(argv[argi], "-j")) {
+                if (parse_number(argv[++argi], 65535, &number)) goto bad_number;
+                threads = number;
+                continue;
+            }
+            if (!strcmp(argv[argi], "-n")) {
+                if (parse_number(argv[++argi], UINT32_MAX, &number))
+                    goto bad_number;
+                instances = number;
+                continue;
+            }
+            if (!strcmp(argv[argi], "-f")) {
+                if (parse_number(argv[++argi], UINT32_MAX, &number))
+                    goto bad_number;
+                frames = number;
+                continue;
+            }
+            if (!strcmp(argv[argi], "-o")) { frames_dir = argv[++argi]; continue; }
+            if (!strcmp(argv[argi], "-g")) { golden = argv[++argi]; continue; }
+            if (!strcmp(argv[argi], "-a")) {
+                if (parse_number(argv[++argi], UINT8_MAX, &number)) goto bad_number;
+                runahead = number;
+                continue;
+            }
+        }
+
+        struct image *image = &images[images_count];
+        image->fname = argv[argi];
+        if (!(image->data = dev_rom_load(image->fname, &image->size))) {
+            fprintf(stderr, "ERROR: Can't load ROM: %s\n", image->fname);
+            return 1;
+        }
+        images_count++;
+        continue;
+
+bad_number:
+        fprintf(stderr, "ERROR: Invalid value for %s: %s\n\n",
+                argv[argi - 1], argv[argi]);
+
+        show_usage(argv);
+        return 1;
+    }
+
+    if (!images_count || !instances) {
+        fprintf(stderr, "ERROR: No ROMs to run.\n\n");
+        show_usage(argv);
+        return 1;
+    }
+
+#ifdef _SC_NPROCESSORS_ONLN
+    if (threads <= 0) threads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (threads <= 0) threads = 1;
+
+    jobs_count = images_count * instances;
+    if (!(jobs = calloc(jobs_count, sizeof(struct job)))) {
+        perror("ERROR: Can't allocate jobs");
+        return 1;
+    }
+
+    for (size_t i = 0; i < jobs_count; i++) {
+        jobs[i].image    = &images[i / instances];
+        jobs[i].instance = i % instances;
+    }
+
+    if ((size_t)threads > jobs_count) threads = jobs_count;
+
+    pthread_t *pool = calloc(threads, sizeof(pthread_t));
+    long started = 0;
+
+    for (; pool && started < threads; started++)
+        if (pthread_create(&pool[started], NULL, worker, NULL)) break;
+
+    if (!started) worker(NULL);
+    for (long t = 0; t < started; t++) pthread_join(pool[t], NULL);
+
+    for (size_t i = 0; i < jobs_count; i++)
+        printf("%s %u %u %08x %llu\n", jobs[i].image->fname,
+               jobs[i].instance, frames, jobs[i].hash,
+               (unsigned long long)jobs[i].instrs);
+
+    size_t failed = golden ? check_golden() : 0;
+    if (golden)
+        fprintf(stderr, "%zu of %zu instances match %s\n",
+                jobs_count - failed, jobs_count, golden);
+
+    for (size_t i = 0; i < images_count; i++) free(images[i].data);
+    free(images);
+    free(jobs);
+    free(pool);
+
+    return failed ? 1 : 0;
+}
+
+
+#undef WIDTH
+#undef HEIGHT
\ No newline at end of file
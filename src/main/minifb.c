@@ -1,93 +1,360 @@
-#include <stdbool.h>
-#include <stdint.h>
-#include <stdio.h>
-#include <stddef.h>
-#include <string.h>
-
-#include <MiniFB.h>
-
-#include "uxn.h"
-#include "dev.h"
-#include "bios.h"
-
-/* ==========================================================================
-   B6X MINIFB BACKEND
-   ========================================================================== */
-
-#define WIDTH 320
-#define HEIGHT 224
-
-static uint32_t buffer[WIDTH * HEIGHT];
-static char win_title[256];
-
-void dev_meta_deo(uint8_t *port) {}
-
-static void ctl_update(struct mfb_window *window, mfb_key key,
-                           mfb_key_mod mod, bool isPressed) {
-    uint8_t code = isPressed << 7;
-
-    switch (key) {
-        case KB_KEY_ESCAPE: mfb_close(window); return;
-        /* Player 1 */
-        case KB_KEY_ENTER: code |= 0x00; break;
-        case KB_KEY_A:     code |= 0x01; break;
-        case KB_KEY_S:     code |= 0x02; break;
-        case KB_KEY_D:     code |= 0x03; break;
-        case KB_KEY_UP:    code |= 0x04; break;
-        case KB_KEY_DOWN:  code |= 0x05; break;
-        case KB_KEY_LEFT:  code |= 0x06; break;
-        case KB_KEY_RIGHT: code |= 0x07; break;
-
-        /* Player 2 */
-        case KB_KEY_KP_0:  code |= 0x08; break;
-        case KB_KEY_Z:     code |= 0x09; break;
-        case KB_KEY_X:     code |= 0x0A; break;
-        case KB_KEY_C:     code |= 0x0B; break;
-        case KB_KEY_KP_5:  code |= 0x0C; break;
-        case KB_KEY_KP_2:  code |= 0x0D; break;
-        case KB_KEY_KP_1:  code |= 0x0E; break;
-        case KB_KEY_KP_3:  code |= 0x0F; break;
-        default: return;
-    }
-
-    dev_ctl(code);
-}
-
-int main(int argc, char **argv) {
-	snprintf(win_title, 256, "B6X %04x", VERSION);
-
-    if(argc < 2) dev_rom_open("boot.rom"); else {
-        dev_rom_open(argv[1]);
-        char *fname = argv[1];
-        for (char *f = argv[1]; *f; f++)
-            if (*f == '/' ||  *f == '\\') fname = f + 1;
-
-        snprintf(win_title, 256, "B6X %04x - %s", VERSION, fname);
-    }
-
-    dev_init();
-
-    memcpy(uxn_ram, bios, bios_len);
-    uxn_eval(0);
-
-    struct mfb_window *window = mfb_open_ex(win_title, WIDTH+32, HEIGHT+32, 0);
-    if (!(window)) goto terminate;
-
-    mfb_set_keyboard_callback(window, ctl_update);
-    mfb_set_viewport(window, 16, 16, 320, 224);
-    mfb_set_target_fps(60);
-
-    int state; do {
-        dev_vdp(buffer);
-        state = mfb_update_ex(window, buffer, WIDTH, HEIGHT);
-        if (state < 0) { window = NULL; break; }
-    } while(mfb_wait_sync(window));
-
-terminate:
-    dev_rom_close();
-    return 0;
-}
-
-
-#undef WIDTH
-#undef HEIGHT
\ No newline at end of file
+#define _POSIX_C_SOURCE 200112L
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+
+#include <MiniFB.h>
+
+#include "uxn.h"
+#include "dev.h"
+#include "prof.h"
+#include "trace.h"
+#include "bios.h"
+
+#ifdef B6X_SHM
+#include "shm.h"
+#endif
+
+/* ==========================================================================
+   B6X MINIFB BACKEND
+   ========================================================================== */
+
+#define WIDTH 320
+#define HEIGHT 224
+
+#define FRAME_NS 16666667 /* - Emulated frame period     */
+#define FRESH    4        /* - Swap slot holds new frame */
+#define KEYS     64       /* - Key ring size, power of 2 */
+
+static char win_title[256];
+
+static struct b6x *machine, *snapshot;
+static struct prof profile;
+static struct trace trace;
+static uint8_t runahead = 0;
+
+static volatile sig_atomic_t dump_trace = 0;  /* - Set by SIGUSR1 */
+
+#ifdef B6X_SHM
+static struct shm export;
+#endif
+
+/* === Shared by the emulation and present threads === */
+static uint32_t frames[3][WIDTH * HEIGHT];
+static uint8_t  swap = 2;                 /* - Slot between the threads */
+static uint8_t  keys[KEYS];
+static uint32_t keys_head, keys_tail;
+static uint64_t present_ns;
+static uint8_t  show_overlay = 0, running = 1;
+
+void dev_meta_deo(struct uxn *u, uint8_t *port) {}
+
+#ifdef SIGUSR1
+static void trace_signal(int signal) {
+    dump_trace = 1;
+}
+#endif
+
+static void key_push(uint8_t code) {
+    uint32_t tail = keys_tail;
+
+    if (tail - __atomic_load_n(&keys_head, __ATOMIC_ACQUIRE) >= KEYS) return;
+    keys[tail & (KEYS - 1)] = code;
+    __atomic_store_n(&keys_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static void key_pop_all(void) {
+    uint32_t head = keys_head,
+             tail = __atomic_load_n(&keys_tail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) dev_ctl(machine, keys[head++ & (KEYS - 1)]);
+    __atomic_store_n(&keys_head, head, __ATOMIC_RELEASE);
+}
+
+static void ctl_update(struct mfb_window *window, mfb_key key,
+                           mfb_key_mod mod, bool isPressed) {
+    uint8_t code = isPressed << 7;
+
+    switch (key) {
+        case KB_KEY_ESCAPE: mfb_close(window); return;
+        case KB_KEY_F1:
+            if (!isPressed) return;
+            __atomic_xor_fetch(&show_overlay, 1, __ATOMIC_RELAXED);
+            return;
+
+        /* Player 1 */
+        case KB_KEY_ENTER: code |= 0x00; break;
+        case KB_KEY_A:     code |= 0x01; break;
+        case KB_KEY_S:     code |= 0x02; break;
+        case KB_KEY_D:     code |= 0x03; break;
+        case KB_KEY_UP:    code |= 0x04; break;
+        case KB_KEY_DOWN:  code |= 0x05; break;
+        case KB_KEY_LEFT:  code |= 0x06; break;
+        case KB_KEY_RIGHT: code |= 0x07; break;
+
+        /* Player 2 */
+        case KB_KEY_KP_0:  code |= 0x08; break;
+        case KB_KEY_Z:     code |= 0x09; break;
+        case KB_KEY_X:     code |= 0x0A; break;
+        case KB_KEY_C:     code |= 0x0B; break;
+        case KB_KEY_KP_5:  code |= 0x0C; break;
+        case KB_KEY_KP_2:  code |= 0x0D; break;
+        case KB_KEY_KP_1:  code |= 0x0E; break;
+        case KB_KEY_KP_3:  code |= 0x0F; break;
+        default: return;
+    }
+
+    key_push(code);
+}
+
+/* Emulation thread: runs at its own pace, never waits for the window */
+static void *emulate(void *arg) {
+    uint8_t back = 0;
+    uint64_t next = prof_now();
+
+    while (__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+        bool overlay = __atomic_load_n(&show_overlay, __ATOMIC_RELAXED);
+        if (overlay && !machine->prof)
+            prof_start(&profile, machine, NULL, 0, 0);
+
+        /* Deliver input as late as possible, dev_vdp runs the vectors */
+        key_pop_all();
+        dev_runahead(machine, snapshot, frames[back], runahead);
+#ifdef B6X_SHM
+        shm_export_frame(&export, frames[back], prof_now());
+#endif
+        if (overlay) prof_overlay(&profile, frames[back], WIDTH, HEIGHT);
+
+        back = __atomic_exchange_n(&swap, back | FRESH, __ATOMIC_ACQ_REL) & 3;
+
+        PROF_ADD(machine, time[PROF_PRESENT],
+                 __atomic_exchange_n(&present_ns, 0, __ATOMIC_RELAXED));
+        prof_frame(&profile);
+
+        if (dump_trace || trace.late) {
+            dump_trace = 0;
+            if (trace_dump(&trace)) perror("ERROR: Can't write trace");
+        }
+
+        uint64_t now = prof_now();
+        if ((next += FRAME_NS) < now) { next = now; continue; }
+
+        struct timespec ts = { next / 1000000000, next % 1000000000 };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+                               &ts, NULL) == EINTR);
+    }
+
+    return NULL;
+}
+
+/* Parses a decimal flag value, non-zero if it is not a number up to max */
+static int parse_number(const char *text, unsigned long max,
+                                          unsigned long *value) {
+    char *end;
+
+    errno  = 0;
+    *value = strtoul(text, &end, 10);
+    return *text < '0' || *text > '9' || *end || errno || *value > max;
+}
+
+static void show_usage(char **argv) {
+    fprintf(stderr, "Usage: %s [flags] [rom]\n", argv[0]);
+    fprintf(stderr, "Run a B6X ROM (default: boot.rom).\n\n");
+
+    fprintf(stderr,
+        "Flags:\n"
+        "  -h            Show this help message\n"
+        "  -p  <file>    Dump frame statistics to file ('-' for stderr)\n"
+        "  -f  <format>  Statistics format: csv or json (default: csv)\n"
+        "  -n  <frames>  Frames per statistics record (default: 60)\n"
+        "  -a  <frames>  Run ahead to hide input lag, up to 255 (default: 0)\n"
+#ifdef B6X_SHM
+        "  -s  <name>    Export frames to a shared-memory ring\n"
+#endif
+        "  -t  <file>    Record an execution trace, dumped to file on exit\n"
+        "  -T  <count>   Trace entries kept (default: 4194304)\n"
+        "  -l            Also dump the -t trace after every late frame\n"
+        "\nPress F1 to toggle the frame timing overlay.\n"
+#ifdef SIGUSR1
+        "Send SIGUSR1 to dump the execution trace while running.\n"
+#endif
+        "\n"
+    );
+}
+
+int main(int argc, char **argv) {
+    char *rom_fname = NULL;
+    char *prof_fname = NULL;
+    char *shm_name = NULL;
+    char *trace_fname = NULL;
+    uint32_t prof_period = 60, trace_entries = TRACE_ENTRIES;
+    int prof_json = 0, trace_late = 0, status = 0;
+    unsigned long number;
+
+    for (int argi = 1; argi < argc; argi++) {
+        if (!strcmp(argv[argi], "-h")) { show_usage(argv); return 0; }
+        if (!strcmp(argv[argi], "-l")) { trace_late = 1; continue; }
+
+        if (argi + 1 < argc) {
+            if (!strcmp(argv[argi], "-p")) { prof_fname = argv[++argi]; continue; }
+            if (!strcmp(argv[argi], "-n")) {
+                if (parse_number(argv[++argi], UINT32_MAX, &number))
+                    goto bad_number;
+                prof_period = number;
+                continue;
+            }
+            if (!strcmp(argv[argi], "-f")) {
+                prof_json = !strcmp(argv[++argi], "json");
+                continue;
+            }
+            if (!strcmp(argv[argi], "-a")) {
+                if (parse_number(argv[++argi], UINT8_MAX, &number)) goto bad_number;
+                runahead = number;
+                continue;
+            }
+            if (!strcmp(argv[argi], "-s")) { shm_name = argv[++argi]; continue; }
+            if (!strcmp(argv[argi], "-t")) { trace_fname = argv[++argi]; continue; }
+            if (!strcmp(argv[argi], "-T")) {
+                if (parse_number(argv[++argi], 1ul << 31, &number))
+                    goto bad_number;
+                trace_entries = number;
+                continue;
+            }
+        }
+
+        if (!rom_fname) { rom_fname = argv[argi]; continue; }
+
+        fprintf(stderr, "ERROR: Invalid argument: %s\n\n", argv[argi]);
+
+        show_usage(argv);
+        return 1;
+
+bad_number:
+        fprintf(stderr, "ERROR: Invalid value for %s: %s\n\n",
+                argv[argi - 1], argv[argi]);
+
+        show_usage(argv);
+        return 1;
+    }
+
+    FILE *prof_out = stderr;
+    if (prof_fname && strcmp(prof_fname, "-") &&
+        !(prof_out = fopen(prof_fname, "w"))) {
+        perror("ERROR: Can't open statistics file");
+        return 1;
+    }
+
+    if (!(machine = calloc(1, sizeof(struct b6x))) ||
+        (runahead && !(snapshot = malloc(sizeof(struct b6x))))) {
+        perror("ERROR: Can't allocate machine");
+        return 1;
+    }
+
+#ifdef B6X_SHM
+    if (shm_name && shm_export_open(&export, shm_name, WIDTH, HEIGHT)) {
+        perror("ERROR: Can't create shared memory");
+        if (errno == EEXIST)
+            fprintf(stderr, "Remove '%s' if no other emulator uses it.\n",
+                    export.name);
+        return 1;
+    }
+#else
+    if (shm_name) {
+        fprintf(stderr, "ERROR: Shared memory export is not supported.\n");
+        return 1;
+    }
+#endif
+
+    dev_init(machine);
+
+    if (trace_fname) {
+        if (trace_start(&trace, &machine->uxn, trace_entries, trace_fname)) {
+            perror("ERROR: Can't allocate trace");
+            return 1;
+        }
+        trace.on_late = trace_late;
+#ifdef SIGUSR1
+        struct sigaction action = { 0 };
+        action.sa_handler = trace_signal;
+        sigaction(SIGUSR1, &action, NULL);
+#endif
+    }
+    else if (trace_late)
+        fprintf(stderr, "WARNING: -l has no effect without -t.\n");
+
+    if (prof_fname)
+        prof_start(&profile, machine, prof_out, prof_json, prof_period);
+
+    snprintf(win_title, 256, "B6X %04x", VERSION);
+
+    if(!rom_fname) dev_rom_open(machine, "boot.rom"); else {
+        dev_rom_open(machine, rom_fname);
+        char *fname = rom_fname;
+        for (char *f = rom_fname; *f; f++)
+            if (*f == '/' ||  *f == '\\') fname = f + 1;
+
+        snprintf(win_title, 256, "B6X %04x - %s", VERSION, fname);
+    }
+
+    memcpy(machine->uxn.ram, bios, bios_len);
+    uxn_eval(&machine->uxn, 0);
+
+    struct mfb_window *window = mfb_open_ex(win_title, WIDTH+32, HEIGHT+32, 0);
+    if (!(window)) goto terminate;
+
+    mfb_set_keyboard_callback(window, ctl_update);
+    mfb_set_viewport(window, 16, 16, 320, 224);
+    mfb_set_target_fps(60);
+
+    pthread_t emulation;
+    if (pthread_create(&emulation, NULL, emulate, NULL)) {
+        perror("ERROR: Can't start emulation thread");
+        mfb_close(window);
+        mfb_update_events(window);
+        status = 1;
+        goto terminate;
+    }
+
+    /* Present thread: always shows the newest finished frame */
+    uint8_t front = 1;
+    int state; do {
+        if (__atomic_load_n(&swap, __ATOMIC_ACQUIRE) & FRESH)
+            front = __atomic_exchange_n(&swap, front, __ATOMIC_ACQ_REL) & 3;
+
+        uint64_t t0 = prof_now();
+        state = mfb_update_ex(window, frames[front], WIDTH, HEIGHT);
+        __atomic_add_fetch(&present_ns, prof_now() - t0, __ATOMIC_RELAXED);
+
+        if (state < 0) { window = NULL; break; }
+    } while(mfb_wait_sync(window));
+
+    __atomic_store_n(&running, 0, __ATOMIC_RELEASE);
+    pthread_join(emulation, NULL);
+
+terminate:
+    if (trace_fname && trace_dump(&trace)) perror("ERROR: Can't write trace");
+    trace_stop(&trace, &machine->uxn);
+    prof_stop(&profile);
+#ifdef B6X_SHM
+    shm_export_close(&export);
+#endif
+    dev_rom_close(machine);
+    free(machine);
+    free(snapshot);
+    return status;
+}
+
+
+#undef WIDTH
+#undef HEIGHT
+#undef FRAME_NS
+#undef FRESH
+#undef KEYS
\ No newline at end of file
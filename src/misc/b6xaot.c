@@ -0,0 +1,277 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* ==========================================================================
+   B6X AHEAD-OF-TIME ROM TRANSLATOR
+   ========================================================================== */
+
+#define PEEK2(addr, mem, mask) \
+    (mem[(addr) & (mask)] << 8 | mem[((addr)+1) & (mask)])
+
+static uint8_t  image[65536];        /* - RAM as left by the BIOS          */
+static uint8_t  code[65536];         /* - Instruction starts               */
+static uint8_t  label[65536];        /* - Targets of static jumps          */
+static uint8_t  queued[65536];
+static uint16_t work[65536];
+static size_t   work_count, limit;
+
+/* === Instruction semantics, as in the interpreter's OPC table === */
+static const char *ops[32][2] = {
+    { 0 },
+    /* INC */ { "DROP(a,d)", "PUSH(a + 1,d)" },
+    /* POP */ { "*p -= 1 + d;", "" },
+    /* NIP */ { "TAKE(x) *p -= 1 + d;", "GIVE(x)" },
+    /* SWP */ { "TAKE(x) TAKE(y)", "GIVE(x) GIVE(y)" },
+    /* ROT */ { "TAKE(x) TAKE(y) TAKE(z)", "GIVE(y) GIVE(x) GIVE(z)" },
+    /* DUP */ { "TAKE(x)", "GIVE(x) GIVE(x)" },
+    /* OVR */ { "TAKE(x) TAKE(y)", "GIVE(y) GIVE(x) GIVE(y)" },
+    /* EQU */ { "DROP(a,d) DROP(b,d)", "PUSH(b == a,0)" },
+    /* NEQ */ { "DROP(a,d) DROP(b,d)", "PUSH(b != a,0)" },
+    /* GTH */ { "DROP(a,d) DROP(b,d)", "PUSH(b > a,0)" },
+    /* LTH */ { "DROP(a,d) DROP(b,d)", "PUSH(b < a,0)" },
+    /* JMP */ { "DROP(a,d)", "pc = d ? a : RELA;" },
+    /* JCN */ { "DROP(a,d) DROP(b,0)", "if(b) pc = d ? a : RELA;" },
+    /* JSR */ { "DROP(a,d)", "FLIP PUSH(pc,1) pc = d ? a : RELA;" },
+    /* STH */ { "TAKE(x)", "FLIP PUSH(x[0],0) if(d) PUSH(x[1],0)" },
+    /* LDZ */ { "DROP(a,0)", "PEEK(a, x, 0xff) GIVE(x)" },
+    /* STZ */ { "DROP(a,0) TAKE(y)", "POKE(a, y, 0xff)" },
+    /* LDR */ { "DROP(a,0)", "PEEK(RELA, x, 0xffff) GIVE(x)" },
+    /* STR */ { "DROP(a,0) TAKE(y)", "POKE(RELA, y, 0xffff)" },
+    /* LDA */ { "DROP(a,1)", "PEEK(a, x, 0xffff) GIVE(x)" },
+    /* STA */ { "DROP(a,1) TAKE(y)", "POKE(a, y, 0xffff)" },
+    /* DEI */ { "DROP(a,0)", "DEVI(a, x) GIVE(x)" },
+    /* DEO */ { "DROP(a,0) TAKE(y)", "DEVO(a, y)" },
+    /* ADD */ { "DROP(a,d) DROP(b,d)", "PUSH(b + a,d)" },
+    /* SUB */ { "DROP(a,d) DROP(b,d)", "PUSH(b - a,d)" },
+    /* MUL */ { "DROP(a,d) DROP(b,d)", "PUSH(b * a,d)" },
+    /* DIV */ { "DROP(a,d) DROP(b,d)", "PUSH(a ? b / a : 0,d)" },
+    /* AND */ { "DROP(a,d) DROP(b,d)", "PUSH(b & a,d)" },
+    /* ORA */ { "DROP(a,d) DROP(b,d)", "PUSH(b | a,d)" },
+    /* EOR */ { "DROP(a,d) DROP(b,d)", "PUSH(b ^ a,d)" },
+    /* SFT */ { "DROP(a,0) DROP(b,d)", "PUSH(b >> (a & 0xf) << (a >> 4),d)" }
+};
+
+static uint8_t op_length(uint8_t op) {
+    switch (op) {
+        case 0x20: case 0x40: case 0x60: case 0xa0: case 0xe0: return 3;
+        case 0x80: case 0xc0: return 2;
+        default: return 1;
+    }
+}
+
+static void add_entry(uint32_t addr) {
+    if (addr >= 0x100 && addr < limit && !queued[addr]++)
+        work[work_count++] = addr;
+}
+
+/* Follow code from addr, queueing every static or literal target */
+static void trace(uint16_t addr) {
+    uint32_t prev = 0x10000;
+
+    while (addr >= 0x100 && addr < limit && !code[addr]) {
+        uint8_t  op = image[addr], len = op_length(op);
+        uint16_t next = addr + len, imm = PEEK2(addr + 1, image, 0xFFFF);
+
+        code[addr] = 1;
+
+        /* Literal address followed by a jump: ;label JMP2, ,label JCN */
+        if (prev < 0x10000 && (op & 0x1f) >= 0x0c && (op & 0x1f) <= 0x0e) {
+            uint8_t lit = image[prev];
+            if ((op & 0xe0) == 0x20 && lit == 0xa0)
+                add_entry(PEEK2(prev + 1, image, 0xFFFF));
+            if ((op & 0xe0) == 0x00 && lit == 0x80)
+                add_entry((uint16_t)(next + (int8_t)image[prev + 1]));
+        }
+
+        /* Vector setup: ;vec #0a DEO2, ;vec #0503 VDPO, ;vec #0703 VDPO */
+        if (op == 0xa0) {
+            uint8_t  n_op  = image[next & 0xFFFF];
+            uint16_t n_imm = PEEK2(next + 1, image, 0xFFFF);
+
+            if ((n_op == 0x80 && image[(next + 1) & 0xFFFF] == 0x0a) ||
+                (n_op == 0xa0 && (n_imm == 0x0503 || n_imm == 0x0703)))
+                add_entry(imm);
+        }
+
+        switch (op) {
+            case 0x00: return;                                     /* BRK */
+            case 0x40: add_entry((uint16_t)(next + imm)); return;  /* JMI */
+            case 0x20:                                             /* JCI */
+            case 0x60: add_entry((uint16_t)(next + imm)); break;   /* JSI */
+        }
+
+        if ((op & 0x3f) == 0x0c || (op & 0x3f) == 0x2c) return;   /* JMP */
+
+        prev = addr;
+        addr = next;
+    }
+}
+
+static int translated(uint32_t addr) {
+    return addr >= 0x100 && addr < limit && code[addr];
+}
+
+/* The case emitted after addr is the next instruction, unless an entry
+   into its operand decoded another instruction in between */
+static int falls_through(uint16_t addr) {
+    uint32_t next = addr + op_length(image[addr]);
+
+    for (uint32_t a = addr + 1; a < next; a++)
+        if (translated(a)) return 0;
+
+    return translated(next);
+}
+
+static void emit(FILE *out, uint16_t addr) {
+    uint8_t  op = image[addr], len = op_length(op), d = op >> 5 & 1,
+             r  = op >> 6 & 1, k = op >> 7;
+    uint16_t next = addr + len, target = next + PEEK2(addr + 1, image, 0xFFFF);
+
+    fprintf(out, "    AOT_%s(0x%04x) ", label[addr] ? "ATL" : "AT", addr);
+
+    switch (op) {
+        case 0x00:
+            fprintf(out, "AOT_OP(0x%04x, 0x00, 0, 1) AOT_BRK\n", addr);
+            return;
+        case 0x20: case 0x40: case 0x60:
+            fprintf(out, "AOT_OPI(0x%04x, 0x%02x, 0x%02x, 0x%02x) ", addr, op,
+                    image[(addr + 1) & 0xFFFF], image[(addr + 2) & 0xFFFF]);
+            if (op == 0x20) fputs("if (DEC) ", out);
+            if (op == 0x60) fputs("INC = pc >> 8; INC = pc; ", out);
+            fprintf(out, code[target] ? "AOT_GOTO(0x%04x) "
+                                      : "AOT_JUMP(0x%04x) ", target);
+            break;
+        case 0x80: case 0xa0: case 0xc0: case 0xe0:
+            fprintf(out, "AOT_OP(0x%04x, 0x%02x, %d, %d) ", addr, op, r, len);
+            for (uint8_t i = 1; i < len; i++)
+                fprintf(out, "INC = u->ram[0x%04x]; ", (addr + i) & 0xFFFF);
+            break;
+        default:
+            fprintf(out, "AOT_OP(0x%04x, 0x%02x, %d, 1) ", addr, op, r);
+            if (k) fprintf(out, "{const int32_t d=%d,k=*p;%s *p=k;%s} ",
+                                d, ops[op & 31][0], ops[op & 31][1]);
+            else   fprintf(out, "{const int32_t d=%d;%s %s} ",
+                                d, ops[op & 31][0], ops[op & 31][1]);
+    }
+
+    fprintf(out, "AOT_NEXT(0x%04x, %d)", addr, len);
+
+    /* Jumping over overlapping code, or leaving for code not translated */
+    if (!falls_through(addr))
+        fprintf(out, translated(next) ? " goto L_0x%04x;" : " goto dispatch;",
+                next);
+    fputc('\n', out);
+}
+
+static void show_usage(char **argv) {
+    fprintf(stderr, "Usage: %s [flags] <input> <output>\n", argv[0]);
+    fprintf(stderr, "Translate the code of a B6X ROM to C.\n");
+    fprintf(stderr, "Build with 'make AOT=<output>' to use the result.\n\n");
+
+    fprintf(stderr,
+        "Flags:\n"
+        "  -h            Show this help message\n"
+        "  -e  <addr>    Also translate from address (16-bit HEX)\n"
+        " [-i] <input>   Input ROM\n"
+        " [-o] <output>  Output C file (required)\n\n"
+    );
+}
+
+int main(int argc, char **argv) {
+    char *in_fname = NULL;
+    char *out_fname = NULL;
+
+    work[work_count++] = 0x0100;
+
+    for (int argi = 1; argi < argc; argi++) {
+        if (argi + 1 >= argc) goto latest_arg;
+
+        if (!strcmp(argv[argi], "-i")) { in_fname  = argv[++argi]; continue; }
+        if (!strcmp(argv[argi], "-o")) { out_fname = argv[++argi]; continue; }
+
+        if (!strcmp(argv[argi], "-e")) {
+            char *endptr;
+            work[work_count++] = strtol(argv[++argi], &endptr, 16);
+            if (*endptr) {
+                fprintf(stderr, "ERROR: Invalid address: %s\n", argv[argi]);
+                return 1;
+            }
+            continue;
+        }
+
+latest_arg:
+
+        if (!strcmp(argv[argi], "-h")) { show_usage(argv); return 0; }
+
+        if (!in_fname)   { in_fname = argv[argi]; continue; }
+        if (!out_fname) { out_fname = argv[argi]; continue; }
+
+        fprintf(stderr, "ERROR: Invalid argument: %s\n\n", argv[argi]);
+
+        show_usage(argv);
+        return 1;
+    }
+
+    if (!in_fname || !out_fname) {
+        fprintf(stderr, "ERROR: Input or output filename is missing.\n\n");
+        show_usage(argv);
+        return 1;
+    }
+
+    /* The BIOS loads the ROM from the first page onward at the same address */
+    FILE *input = fopen(in_fname, "rb");
+    if (!input) { perror("ERROR: Can't open input file"); return 1; }
+
+    limit = fread(image, 1, sizeof(image), input);
+    fclose(input);
+
+    if (limit <= 0x100 || memcmp(image, "UXNR", 4)) {
+        fprintf(stderr, "ERROR: Not a B6X ROM: %s\n", in_fname);
+        return 1;
+    }
+
+    while (work_count) trace(work[--work_count]);
+
+    size_t count = 0;
+    for (size_t addr = 0x100; addr < limit; addr++) {
+        if (!code[addr]) continue;
+        count++;
+
+        uint8_t  op = image[addr];
+        uint16_t target = addr + 3 + PEEK2(addr + 1, image, 0xFFFF);
+        if ((op == 0x20 || op == 0x40 || op == 0x60) && code[target])
+            label[target] = 1;
+        if (!falls_through(addr) && translated(addr + op_length(op)))
+            label[addr + op_length(op)] = 1;
+    }
+
+    FILE *output = fopen(out_fname, "w");
+    if (!output) { perror("ERROR: Can't open output file"); return 1; }
+
+    fprintf(output, "/* Translated from %s by b6xaot, %zu instructions */\n\n",
+                    in_fname, count);
+
+    /* Header 0x81: ROM window page count, see dev_rom_attach */
+    if (image[0x81]) fputs("#define AOT_WINDOW\n", output);
+
+    fputs("#include \"aot.h\"\n\n"
+          "uint32_t aot_eval(struct uxn *u, uint16_t pc) {\n"
+          "    AOT_BEGIN\n", output);
+
+    for (size_t addr = 0x100; addr < limit; addr++)
+        if (code[addr]) emit(output, addr);
+
+    fputs("    AOT_END\n}\n", output);
+
+    if (ferror(output) | fclose(output)) {
+        perror("ERROR: Can't write output file");
+        return 1;
+    }
+
+    fprintf(stderr, "%s: %zu instructions translated\n", in_fname, count);
+    return 0;
+}
+
+#undef PEEK2
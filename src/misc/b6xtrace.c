@@ -0,0 +1,343 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "trace.h"
+
+/* ==========================================================================
+   B6X EXECUTION TRACE ANALYZER
+   ========================================================================== */
+
+#define VECTORS   8    /* - Vectors listed per frame                 */
+#define MAX_DEPTH 256  /* - Deeper calls are folded into their caller */
+
+/* === Per-frame timeline === */
+struct vector {
+    uint16_t addr;
+    int16_t  line;            /* - Scanline when entered, -1 outside     */
+    uint32_t start, us;
+    uint64_t instr;
+};
+
+struct frame {
+    int32_t  number;          /* - -1 before the first frame marker       */
+    uint32_t start;
+    uint64_t instr, deo, dei;
+    uint32_t vectors;
+    struct vector vector[VECTORS];
+};
+
+/* === Call tree, children are always created after their parent === */
+struct node {
+    uint16_t addr;
+    uint32_t parent, child, sibling;
+    uint64_t calls, self, total;
+};
+
+static struct node *nodes;
+static uint32_t     node_count, node_cap;
+
+static int      timeline = 1, calltree = 1;
+static uint32_t max_depth = 8;
+static double   min_percent = 1.0;
+
+static uint32_t node_new(uint32_t parent, uint16_t addr) {
+    if (node_count == node_cap) {
+        node_cap = node_cap ? node_cap * 2 : 1024;
+        if (!(nodes = realloc(nodes, node_cap * sizeof(struct node)))) {
+            perror("ERROR: Can't allocate call tree");
+            exit(1);
+        }
+    }
+
+    nodes[node_count] = (struct node){ .addr = addr, .parent = parent };
+    return node_count++;
+}
+
+static uint32_t node_child(uint32_t parent, uint16_t addr) {
+    uint32_t last = 0;
+
+    for (uint32_t c = nodes[parent].child; c; last = c, c = nodes[c].sibling)
+        if (nodes[c].addr == addr) return c;
+
+    uint32_t child = node_new(parent, addr);
+    if (last) nodes[last].sibling = child; else nodes[parent].child = child;
+
+    return child;
+}
+
+/* Frames late as the emulator's -l sees them are marked with '*',
+   prev is the start of the frame before, -1 for none */
+static void frame_print(const struct frame *f, uint32_t first, int64_t prev) {
+    if (!timeline) return;
+
+    if (f->number < 0) printf("%6s %10s %9s", "-", "-", "-");
+    else if (prev < 0)
+        printf("%6d %10.3f %9s", f->number, (f->start - first) / 1000.0, "-");
+    else {
+        uint32_t delta = f->start - (uint32_t)prev;
+        printf("%6d %10.3f %8.3f%c", f->number, (f->start - first) / 1000.0,
+               delta / 1000.0, delta > TRACE_LATE_US ? '*' : ' ');
+    }
+
+    printf(" %10llu %5llu %5llu ", (unsigned long long)f->instr,
+           (unsigned long long)f->deo, (unsigned long long)f->dei);
+
+    for (uint32_t i = 0; i < f->vectors && i < VECTORS; i++) {
+        const struct vector *v = &f->vector[i];
+        printf(" %04x", v->addr);
+        if (v->line >= 0) printf("@%d", v->line);
+        printf(":%llu/%.2f", (unsigned long long)v->instr, v->us / 1000.0);
+    }
+    if (f->vectors > VECTORS) printf(" +%u more", f->vectors - VECTORS);
+
+    putchar('\n');
+}
+
+static int by_total(const void *a, const void *b) {
+    uint64_t ta = nodes[*(const uint32_t *)a].total,
+             tb = nodes[*(const uint32_t *)b].total;
+    return ta < tb ? 1 : ta > tb ? -1 : 0;
+}
+
+static void node_print(uint32_t index, uint32_t depth, uint64_t all) {
+    const struct node *n = &nodes[index];
+
+    /* Instructions of a vector whose start was overwritten in the ring */
+    if (!index && n->self)
+        printf("%8s %12llu %12llu %6.2f%%  (partial)\n", "-",
+               (unsigned long long)n->self, (unsigned long long)n->self,
+               n->self * 100.0 / all);
+
+    if (index) {
+        if (n->total * 100.0 < min_percent * all) return;
+
+        printf("%8llu %12llu %12llu %6.2f%%  %*s%s%04x\n",
+               (unsigned long long)n->calls, (unsigned long long)n->total,
+               (unsigned long long)n->self, n->total * 100.0 / all,
+               (int)(depth - 1) * 2, "", n->parent ? "" : "vector ", n->addr);
+    }
+
+    if (depth >= max_depth) return;
+
+    uint32_t count = 0, *children;
+    for (uint32_t c = n->child; c; c = nodes[c].sibling) count++;
+    if (!count || !(children = malloc(count * sizeof(uint32_t)))) return;
+
+    count = 0;
+    for (uint32_t c = n->child; c; c = nodes[c].sibling) children[count++] = c;
+    qsort(children, count, sizeof(uint32_t), by_total);
+
+    for (uint32_t i = 0; i < count; i++)
+        node_print(children[i], depth + 1, all);
+
+    free(children);
+}
+
+static int parse_number(const char *text, unsigned long max,
+                                          unsigned long *value) {
+    char *end;
+
+    errno  = 0;
+    *value = strtoul(text, &end, 10);
+    return *text < '0' || *text > '9' || *end || errno || *value > max;
+}
+
+static int parse_percent(const char *text, double *value) {
+    char *end;
+
+    errno  = 0;
+    *value = strtod(text, &end);
+    return (*text != '.' && (*text < '0' || *text > '9')) || *end || errno ||
+           !(*value <= 100.0);
+}
+
+static void show_usage(char **argv) {
+    fprintf(stderr, "Usage: %s [flags] <trace>\n", argv[0]);
+    fprintf(stderr, "Show the frame timeline and call tree of a B6X trace.\n\n");
+
+    fprintf(stderr,
+        "Flags:\n"
+        "  -h            Show this help message\n"
+        "  -t            Frame timeline only\n"
+        "  -c            Call tree only\n"
+        "  -d  <depth>   Call tree depth (default: 8)\n"
+        "  -m  <percent> Hide calls below percent of instructions (default: 1)\n"
+        " [-i] <trace>   Trace file, written by 'b6x -t'\n\n"
+    );
+}
+
+int main(int argc, char **argv) {
+    char *in_fname = NULL;
+
+    for (int argi = 1; argi < argc; argi++) {
+        if (!strcmp(argv[argi], "-h")) { show_usage(argv); return 0; }
+        if (!strcmp(argv[argi], "-t")) { calltree = 0; continue; }
+        if (!strcmp(argv[argi], "-c")) { timeline = 0; continue; }
+
+        if (argi + 1 < argc) {
+            if (!strcmp(argv[argi], "-i")) { in_fname = argv[++argi]; continue; }
+            if (!strcmp(argv[argi], "-d")) {
+                unsigned long number;
+
+                if (parse_number(argv[++argi], MAX_DEPTH, &number))
+                    goto bad_number;
+                max_depth = number;
+                continue;
+            }
+            if (!strcmp(argv[argi], "-m")) {
+                if (parse_percent(argv[++argi], &min_percent))
+                    goto bad_number;
+                continue;
+            }
+        }
+
+        if (!in_fname) { in_fname = argv[argi]; continue; }
+
+        fprintf(stderr, "ERROR: Invalid argument: %s\n\n", argv[argi]);
+
+        show_usage(argv);
+        return 1;
+
+bad_number:
+        fprintf(stderr, "ERROR: Invalid value for %s: %s\n\n",
+                argv[argi - 1], argv[argi]);
+
+        show_usage(argv);
+        return 1;
+    }
+
+    if (!in_fname) {
+        fprintf(stderr, "ERROR: Trace filename is missing.\n\n");
+        show_usage(argv);
+        return 1;
+    }
+
+    FILE *input = fopen(in_fname, "rb");
+    if (!input) { perror("ERROR: Can't open trace file"); return 1; }
+
+    uint8_t header[20];
+    if (fread(header, sizeof header, 1, input) != 1 ||
+        memcmp(header, "B6XT", 4) || header[4] != 1 || header[6] != 8) {
+        fprintf(stderr, "ERROR: Not a B6X trace: %s\n", in_fname);
+        return 1;
+    }
+
+    uint64_t count = 0, recorded = 0;
+    for (uint8_t i = 0; i < 4; i++) count    |= (uint64_t)header[8 + i] << (i << 3);
+    for (uint8_t i = 0; i < 8; i++) recorded |= (uint64_t)header[12 + i] << (i << 3);
+
+    printf("%s: %llu entries, %llu older ones overwritten\n\n", in_fname,
+           (unsigned long long)count, (unsigned long long)(recorded - count));
+
+    node_new(0, 0);                   /* - Root, parent of the vectors */
+
+    struct frame frame = { .number = -1 };
+    struct vector *vector = NULL;
+    uint32_t current = 0, depth = 0, folded = 0, first = 0, skipped = 0;
+    int64_t  prev = -1;
+    uint8_t  call = 0, started = 0, ahead = 0;
+    int16_t  line = -1;
+
+    if (timeline)
+        printf("%6s %10s %9s %10s %5s %5s  Vectors (addr@line:instr/ms)\n",
+               "Frame", "Start ms", "Delta ms", "Instr", "DEO", "DEI");
+
+    for (uint8_t b[8]; fread(b, sizeof b, 1, input) == 1;) {
+        struct trace_entry e = { b[0], b[1], b[2] | b[3] << 8,
+                                 b[4] | b[5] << 8 | b[6] << 16 |
+                                 (uint32_t)b[7] << 24 };
+
+        /* Frames run ahead are rolled back, the real frame goes on after */
+        if (e.kind == TRACE_FRAME) {
+            if (e.op && !ahead) skipped++;
+            ahead = e.op;
+        }
+        if (ahead) continue;
+
+        switch (e.kind) {
+            case TRACE_OP:
+                frame.instr++;
+                if (vector) vector->instr++;
+
+                if (call) {
+                    call = 0;
+                    if (depth < MAX_DEPTH) {
+                        current = node_child(current, e.addr);
+                        nodes[current].calls++;
+                        depth++;
+                    } else folded++;
+                }
+                nodes[current].self++;
+
+                /* JSR in any mode, JSI; JMP2r returns */
+                if ((e.op & 0x1f) == 0x0e || e.op == 0x60) call = 1;
+                else if (e.op == 0x6c) {
+                    if (folded) folded--;
+                    else if (depth) { depth--; current = nodes[current].parent; }
+                }
+                break;
+
+            case TRACE_VECTOR:
+                current = node_child(0, e.addr);
+                nodes[current].calls++;
+                depth = folded = call = 0;
+
+                if (frame.vectors++ < VECTORS) {
+                    vector = &frame.vector[frame.vectors - 1];
+                    *vector = (struct vector){ e.addr, line, e.data, 0, 0 };
+                } else vector = NULL;
+                break;
+
+            case TRACE_BRK:
+                if (vector) vector->us = e.data - vector->start;
+                vector = NULL;
+                current = depth = folded = call = 0;
+                break;
+
+            case TRACE_DEO: frame.deo++; break;
+            case TRACE_DEI: frame.dei++; break;
+
+            case TRACE_FRAME:
+                if (!started) first = e.data;
+                if (started || frame.instr || frame.vectors)
+                    frame_print(&frame, first, prev);
+
+                prev = started ? (int64_t)frame.start : -1;
+                started = 1;
+
+                frame = (struct frame){ .number = e.addr, .start = e.data };
+                vector = NULL;
+                line = -1;
+                break;
+
+            case TRACE_LINE: line = e.addr; break;
+        }
+    }
+
+    if (started || frame.instr || frame.vectors)
+        frame_print(&frame, first, prev);
+    if (timeline && skipped)
+        printf("%u run-ahead passes left out\n", skipped);
+    fclose(input);
+
+    if (!calltree) return 0;
+
+    for (uint32_t i = node_count; i-- > 0;) {
+        nodes[i].total += nodes[i].self;
+        if (i) nodes[nodes[i].parent].total += nodes[i].total;
+    }
+
+    if (timeline) putchar('\n');
+    printf("%8s %12s %12s %7s  %s\n", "Calls", "Instr", "Self", "Share",
+           "Routine");
+    if (nodes[0].total) node_print(0, 0, nodes[0].total);
+
+    free(nodes);
+    return 0;
+}
+
+#undef VECTORS
+#undef MAX_DEPTH
@@ -26,6 +26,7 @@ static void show_usage(char **argv) {
         "  -t  <title>   Title (up to 48 chars)\n"
         "  -c  <author>  Author string (up to 32 chars)\n"
         "  -v  <version> Target B6X version (16-bit HEX, default: %04x)\n"
+        "  -w  <window>  ROM window first page and page count (HEX, e.g. c040)\n"
         " [-i] <input>   Input ROM (use '-' for stdin)\n"
         " [-o] <output>  Output ROM (required)\n\n", VERSION
     );
@@ -39,6 +40,7 @@ int main (int argc, char **argv) {
     char *author = "";
 
     uint16_t target_ver = VERSION;
+    uint16_t window = 0;
 
     for (int argi = 1; argi < argc; argi++) {
         if (argi + 1 >= argc) goto latest_arg;
@@ -59,6 +61,16 @@ int main (int argc, char **argv) {
             continue;
         }
 
+        if (!strcmp(argv[argi], "-w")) {
+            char *endptr;
+            window = strtol(argv[++argi], &endptr, 16);
+            if (*endptr) {
+                fprintf(stderr, "ERROR: Invalid ROM window: %s\n", argv[argi]);
+                return 1;
+            }
+            continue;
+        }
+
 latest_arg:
 
         if (!strcmp(argv[argi], "-h")) { show_usage(argv); return 0; }
@@ -131,6 +143,7 @@ latest_arg:
     POKE2(98, page, 255, page_count);     /* 0x62: Page count */
     time_t t = time(NULL);
     memcpy(page+112, &t, sizeof(time_t)); /* 0x70: Time */
+    POKE2(128, page, 255, window);        /* 0x80: ROM window */
 
     fseek(output, 0, SEEK_SET);
 